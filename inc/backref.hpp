@@ -0,0 +1,32 @@
+#pragma once
+
+#include "nfa.hpp"
+#include "matching.hpp"
+#include <string_view>
+#include <vector>
+
+// One match of an Nfa: its bounds and, per capture slot, the last span recorded
+// (unbounded when the group did not take part)
+struct NfaMatch {
+    size_t start = unbounded;
+    size_t end = unbounded;
+    std::vector<size_t> starts;
+    std::vector<size_t> ends;
+};
+
+// Lock-step simulation of an Nfa, capture and REF states included. Each thread carries
+// the spans it recorded, shared with the threads it forked from until it records its
+// own; a REF compares against its span with one memcmp and resumes the thread that many
+// bytes later. Threads with the same state and spans are merged, keeping the earliest
+// start, so nothing is backtracked and one pass serves every start. Finds the
+// leftmost-longest match beginning at or after from, or exactly at from when anchored,
+// then with all the next one from where it ends, and so on; matches longer than
+// max_length are not looked for. While a match may still grow, the search for the next
+// one runs alongside it, so each byte is scanned once. Returns the number appended
+size_t find_matches(const Nfa& nfa, std::string_view input, size_t from, bool anchored, bool all, size_t max_length, std::vector<NfaMatch>& matches);
+// The first of find_matches
+bool longest_match(const Nfa& nfa, std::string_view input, size_t from, bool anchored, size_t max_length, NfaMatch& match);
+
+// Whole-input match of a compile_ref_nfa automaton; on a match the spans its REFs
+// read are left in scratch start/size
+bool ref_match(const Nfa& nfa, std::string_view input, MatchScratch& scratch);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "pattern.hpp"
+#include <ostream>
+#include <string_view>
+
+// Writes `inline bool name(std::string_view input)`, standalone C++ answering the
+// whole-input question of query_pattern's EXISTS mode. The pattern's DFA is expanded
+// ahead of time into gotos between switch statements, runs of single bytes into
+// unrolled compares, and self-loops into while loops, after a guard on the lengths
+// gen_frags derived. False, writing nothing, for patterns with back-references or a
+// DFA past max_dfa_states
+bool generate_matcher(const CompiledPattern& pattern, std::string_view name, std::ostream& out);
+bool is_identifier(std::string_view name);
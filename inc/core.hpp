@@ -4,6 +4,11 @@
 #include <string_view>
 #include <vector>
 #include <memory>
+#include <bit>
+#include <bitset>
+#include <span>
+#include <limits>
+#include <cstdint>
 
 // Enums for regex parsing
 
@@ -55,16 +60,79 @@ enum class GroupType : size_t {
     REF,
 };
 
+// Compiled byte class of a leaf, one bit per input byte
+using CharClass = std::bitset<256>;
+
+// Bytes 64 * k to 64 * k + 63 of cls, byte 64 * k + j at bit j
+inline uint64_t class_word(const CharClass& cls, size_t k) {
+    return ((cls >> (64 * k)) & CharClass{~uint64_t{0}}).to_ullong();
+}
+
+// visit(b) for every byte b in cls, ascending
+template <typename F>
+void for_each_byte(const CharClass& cls, F&& visit) {
+    for (size_t k = 0; k < 4; k++) {
+        for (uint64_t word = class_word(cls, k); word; word &= word - 1) visit(64 * k + std::countr_zero(word));
+    }
+}
+
+// Typed length equations, built by gen_frags
+
+enum class VarType : size_t {
+    NONE,
+    X,
+    B,
+};
+
+enum class RelType : size_t {
+    EQ,
+    LE,
+};
+
+// Repetition count (X, bounded by n..m) or alternation switch (B, 0/1)
+struct Var {
+    VarType type = VarType::NONE;
+    size_t id = 0;
+    size_t n = 0;
+    size_t m = 0;
+};
+
+// coeff * vars[0] * vars[1] * ...
+struct Term {
+    size_t coeff = 0;
+    std::vector<Var> vars;
+};
+
+using Frag = std::vector<Term>;
+
+// A stored x_frag term: coeff times ExprTree::term_vars[first_var, first_var + var_count)
+struct FragTerm {
+    size_t coeff = 0;
+    uint32_t first_var = 0;
+    uint32_t var_count = 0;
+};
+
+struct Constraint {
+    Frag lhs;
+    RelType rel = RelType::EQ;
+    size_t rhs = 0;
+};
+
 struct Expr;
 
 struct Equation {
     std::string text;
-    std::vector<Expr*> traversed;
+    // Expr::self of the nodes the equation covers
+    std::vector<uint32_t> traversed;
 
-    Equation(std::string t = {}, std::vector<Expr*> tr = {})
+    Equation(std::string t = {}, std::vector<uint32_t> tr = {})
         : text(std::move(t)), traversed(std::move(tr)) {}
 };
 
+constexpr uint32_t no_node = std::numeric_limits<uint32_t>::max();
+
+// Hot node fields only; nodes live in one contiguous ExprTree::nodes array,
+// children of a node are contiguous and addressed by 32-bit indices
 struct Expr {
     GroupType group_type;
     OpType op_type;
@@ -72,22 +140,20 @@ struct Expr {
     std::string_view group;
     std::string_view op;
     std::string_view link;
-    size_t ref_id;
-    size_t idx;
-    size_t depth;
-    Expr* parent;
-    std::vector<std::unique_ptr<Expr>> children;
-    std::vector<Equation> eqs;
-    std::string x_frag;
-    std::vector<std::string> b_eqs;
-
-    std::string xvar;
-    std::string bvar;
+    uint32_t ref_id;
+    uint32_t idx;
+    uint32_t depth;
+    uint32_t self;
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t child_count;
+
     size_t n;
     size_t m;
-    size_t start;
-    size_t size;
-    bool active;
+    CharClass cls;
+    // A leaf's atoms, one per byte it consumes: ExprTree::atoms[first_atom, first_atom + atom_count)
+    uint32_t first_atom = 0;
+    uint32_t atom_count = 0;
 
     Expr(GroupType group_type = GroupType::IMPLICIT,
          OpType op_type = OpType::ONE,
@@ -95,20 +161,63 @@ struct Expr {
          std::string_view group = "",
          std::string_view op = "",
          std::string_view link = "",
-         size_t ref_id = 0,
-         size_t idx = 0,
-         size_t depth = 0,
-         Expr* parent = nullptr,
-         std::vector<std::unique_ptr<Expr>> children = {},
-         std::vector<Equation> eqs = {},
-         std::string x_frag = {},
-         std::vector<std::string> b_eqs = {},
-         std::string xvar = "",
-         std::string bvar = "",
+         uint32_t ref_id = 0,
+         uint32_t idx = 0,
+         uint32_t depth = 0,
+         uint32_t self = 0,
+         uint32_t parent = no_node,
+         uint32_t first_child = no_node,
+         uint32_t child_count = 0,
          size_t n = 0,
          size_t m = 0,
-         size_t start = 0,
-         size_t size = 0,
-         bool active = true);
+         CharClass cls = {});
+};
+
+constexpr size_t unbounded = std::numeric_limits<size_t>::max();
+
+// Lengths an expr can match: min..max (max may be unbounded), all congruent to min
+// modulo period; period 0 means min is the only length
+struct LengthSet {
+    size_t min = 0;
+    size_t max = unbounded;
+    size_t period = 1;
+};
+
+// Cold per-node fields written by gen_frags and gen_lengths, indexed by Expr::self. The
+// node's x_frag is ExprTree::terms[first_term, first_term + term_count), see x_frag()
+struct ExprCold {
+    uint32_t first_term = 0;
+    uint32_t term_count = 0;
+    Var xvar;
+    Var bvar;
+    LengthSet lengths;
 };
 
+// Arena owning a whole parse tree; nodes[0] is the root
+struct ExprTree {
+    std::vector<Expr> nodes;
+    std::vector<ExprCold> cold;
+    // Byte class of every leaf atom, leaves in node order, see index_atoms
+    std::vector<CharClass> atoms;
+    // Every node's x_frag terms and their variables, so no node owns an allocation
+    std::vector<FragTerm> terms;
+    std::vector<Var> term_vars;
+};
+
+// Tree navigation
+std::span<Expr> children(Expr& expr);
+std::span<const Expr> children(const Expr& expr);
+Expr* parent_of(Expr& expr);
+const Expr* parent_of(const Expr& expr);
+bool is_leaf(const Expr& expr);
+
+// Arena access
+uint32_t add_nodes(ExprTree& tree, size_t count);
+Expr& root(ExprTree& tree);
+const Expr& root(const ExprTree& tree);
+ExprCold& cold(ExprTree& tree, const Expr& expr);
+const ExprCold& cold(const ExprTree& tree, const Expr& expr);
+
+// Arithmetic saturating at unbounded
+size_t sat_mul(size_t a, size_t b);
+size_t sat_add(size_t a, size_t b);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "nfa.hpp"
+#include "matching.hpp"
+#include <string_view>
+#include <vector>
+
+// Whole-input matches of a compile_count_nfa automaton, each reported as the counts its
+// repetitions ended with, in count_node order: 0 for a repetition never entered, and the
+// last pass's count for one nested in another. Threads run in lock step, in priority
+// order, carrying their counts and the spans their REFs read; a REF consumes one byte
+// per step. ALL and COUNT keep threads with different counts apart and yield every
+// distinct vector once, the first being the one FIRST gives; EXISTS and FIRST merge
+// them, keeping the thread a backtracking matcher would try first, and stop at its
+// match. Returns the number of vectors; COUNT does not store them
+size_t derive_counts(const Nfa& nfa, std::string_view input, MatchMode mode, std::vector<std::vector<size_t>>& matches);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "nfa.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Lazily built DFA over one Nfa: each state is an epsilon-closed set of NFA states,
+// transitions are filled per byte class the first time they are taken. Mutable, so
+// it lives in the per-thread MatchScratch rather than in the shared pattern
+struct DfaCache {
+    uint64_t nfa_id = 0;
+    std::vector<std::vector<uint32_t>> sets;
+    std::vector<uint8_t> accept;
+    // sets.size() x nfa->rep.size(), no_node when not built yet
+    std::vector<uint32_t> next;
+    std::unordered_map<std::string, uint32_t> ids;
+    uint32_t start = no_node;
+    // Scratch for closures, one mark per NFA state
+    std::vector<uint32_t> marks;
+    uint32_t generation = 0;
+};
+
+// States kept before the cache is flushed and rebuilt from the current state
+constexpr size_t max_dfa_states = 4096;
+
+// Whole-input match, linear in the input length
+bool dfa_match(const Nfa& nfa, DfaCache& cache, std::string_view input);
+// Builds every state reachable from the start, filling all of next; false when that
+// takes more than max_dfa_states states
+bool build_dfa(const Nfa& nfa, DfaCache& cache);
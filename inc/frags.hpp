@@ -2,15 +2,42 @@
 
 #include "core.hpp"
 #include <string>
+#include <string_view>
 #include <vector>
 
 // Fragment gen
-void gen_frags(Expr& expr, size_t& xvar_count, size_t& bvar_count);
-std::string gen_eqs(const Expr& expr, size_t input_size);
+void gen_frags(ExprTree& tree, Expr& expr, size_t& xvar_count, size_t& bvar_count);
+void gen_frags(ExprTree& tree);
+// A node's x_frag, rebuilt from the tree's term pool
+Frag x_frag(const ExprTree& tree, const Expr& expr);
+void store_frag(ExprTree& tree, const Expr& expr, const Frag& frag);
+std::vector<Constraint> gen_system(const ExprTree& tree, size_t input_size);
+std::string gen_eqs(const ExprTree& tree, size_t input_size);
+void collect_b_eqs(const ExprTree& tree, const Expr& expr, std::vector<Constraint>& b_eqs, bool is_root = false);
+Frag to_beq(const Frag& x_frag);
+
+// Static length analysis, run after gen_frags
+const LengthSet& gen_lengths(ExprTree& tree, const Expr& expr);
+void gen_lengths(ExprTree& tree);
+bool admits_length(const LengthSet& lengths, size_t length);
 
 // Fragment manipulation
-void scalar_mult_frag(std::string& frag, std::string& c);
-void scalar_mult_eqs(std::vector<Equation>& eqs, std::string& c);
+void scalar_mult_frag(Frag& frag, const Var& c);
+
+// Rendering, for debug output and solve_eq
+std::string var_name(const Var& var);
+std::string to_string(const Var& var);
+std::string to_string(const Term& term);
+std::string to_string(const Frag& frag);
+std::string to_string(const Constraint& con);
+
+// Parsing of rendered equations
+Var parse_var(std::string_view token);
+Term parse_term(std::string_view text);
+Frag parse_frag(std::string_view text);
+Constraint parse_constraint(std::string_view text);
 
 // Utility
-std::string n_m_to_xvar(size_t n, size_t m, size_t xvar_count);
+bool is_bvar(const Var& var);
+bool is_constant(const Term& term);
+Var n_m_to_xvar(size_t n, size_t m, size_t xvar_count);
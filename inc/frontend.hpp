@@ -0,0 +1,30 @@
+#pragma once
+
+#include "core.hpp"
+#include "pattern.hpp"
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+// Lines of a stream, or of a mapped file, whose lines are views into the mapping
+struct LineReader {
+    std::istream* in = nullptr;
+    std::string_view mapped;
+    size_t pos = 0;
+};
+
+// A line read from a stream lives in storage until the next call
+bool read_line(LineReader& reader, std::string& storage, std::string_view& line);
+
+bool parse_match_mode(std::string_view name, MatchMode& mode);
+void print_batch_result(size_t line_no, const MatchResult& result, MatchMode mode, std::ostream& out);
+void print_expr(const ExprTree& tree, const Expr& expr, const MatchScratch& scratch, std::ostream& out, int indent = 0);
+
+// Parse and prepare the regex once, then match every newline-delimited input line against it
+int run_batch(const std::string& regex, LineReader& reader, std::ostream& out, MatchMode mode);
+// Same output as run_batch; chunks of lines are matched on the pool, each worker
+// with its own scratch, and written back in input order
+int run_batch_parallel(const std::string& regex, LineReader& reader, std::ostream& out, size_t threads, MatchMode mode);
+// Prompts for a regex and one input, prints the tree, then one "match:" line per
+// count vector (or "no match"), answered by query_pattern like --batch in ALL mode
+int run_interactive(std::istream& in, std::ostream& out);
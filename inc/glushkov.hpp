@@ -0,0 +1,23 @@
+#pragma once
+
+#include "nfa.hpp"
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Position automaton with one bit per NFA class state, bit 0 being the start. A step
+// is one table lookup per 8 active bits and an AND with the byte's position mask
+struct Glushkov {
+    size_t positions = 0;
+    std::array<uint64_t, 256> byte_mask{};
+    // follow[k][b]: positions reachable from the active positions b << 8k
+    std::array<std::array<uint64_t, 256>, 8> follow{};
+    uint64_t accept = 0;
+};
+
+constexpr size_t max_glushkov_positions = 63;
+
+// False when the automaton has more than max_glushkov_positions class states or reads
+// back-references
+bool compile_glushkov(const Nfa& nfa, Glushkov& glushkov);
+bool glushkov_match(const Glushkov& glushkov, std::string_view input);
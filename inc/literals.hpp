@@ -0,0 +1,42 @@
+#pragma once
+
+#include "core.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Byte string every match must contain: a run of adjacent plain-text leaves that sit
+// on a path of concatenations and at-least-once repetitions from the root
+struct RequiredLiteral {
+    std::string text;
+    // Expr::self of the leaves the text was built from
+    std::vector<uint32_t> leaves;
+};
+
+// Longest literals first, since they are the rarest
+void extract_literals(const ExprTree& tree, std::vector<RequiredLiteral>& literals);
+bool is_plain_text(std::string_view text);
+
+// Aho-Corasick automaton over many literals, finding all of them in one pass. The
+// transition table is complete, with one column per byte that occurs in some literal
+// and one shared by all other bytes, which always lead back to the root
+struct LiteralAutomaton {
+    std::array<uint16_t, 256> byte_class{};
+    size_t classes = 1;
+    // states x classes, state 0 being the root
+    std::vector<uint32_t> next;
+    // Per state, the literal ending there and the nearest proper suffix state ending
+    // one; no_node when none
+    std::vector<uint32_t> literal;
+    std::vector<uint32_t> output;
+    // Per literal, its state
+    std::vector<uint32_t> ends;
+};
+
+// Literals must be distinct and non-empty; ids are their indices
+void build_literal_automaton(const std::vector<std::string>& literals, LiteralAutomaton& automaton);
+// Appends the id of every literal occurring in input, once each. reported is per-state
+// scratch, all false between calls
+void find_literals(const LiteralAutomaton& automaton, std::string_view input, std::vector<uint8_t>& reported, std::vector<uint32_t>& found);
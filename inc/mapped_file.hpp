@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only mapping of a whole file, advised for one sequential pass. open() is false
+// when the path cannot be mapped (missing, or not a regular file such as a pipe);
+// an empty file opens as an empty view. Opening again releases the previous mapping
+struct MappedFile {
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    std::string_view view() const;
+
+private:
+    void release();
+
+    void* data = nullptr;
+    size_t size = 0;
+};
+
+// The line starting at pos without its '\n', moving pos past it; false at the end of
+// text. Splits like std::getline, so a last line lacking '\n' still counts
+bool next_line(std::string_view text, size_t& pos, std::string_view& line);
@@ -1,16 +1,127 @@
 #pragma once
 
 #include "core.hpp"
+#include "simd.hpp"
+#include "dfa.hpp"
 #include <string_view>
 #include <unordered_map>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+#include <string>
+#include <atomic>
 
+// Text carried up the tree by match_up, as indices into ExprTree::atoms
+using AtomString = std::vector<uint32_t>;
+
+// (expr, matched width, atoms) entries carried up the tree by match_up
+using UpExpr = std::tuple<const Expr*, size_t, AtomString>;
+
+// What a query needs back: any match, the first match, the number of matches, or all of them
+enum class MatchMode : size_t {
+    EXISTS,
+    FIRST,
+    COUNT,
+    ALL,
+};
+
+// Per-leaf run lengths over one input, see leaf_runs
+struct RunTable {
+    std::vector<size_t> run;
+    size_t max_chain = 0;
+};
+
+// Sub-problem results of a match_down search over one fixed input
+struct MatchMemo {
+    std::unordered_map<std::string, std::vector<std::vector<size_t>>> down;
+    std::unordered_map<std::string, std::vector<std::vector<size_t>>> up;
+    std::unordered_map<std::string, RunTable> runs;
+    std::unordered_map<std::string, size_t> down_count;
+    std::unordered_map<std::string, size_t> up_count;
+};
+
+// Per-input state of one match against a shared, immutable tree, indexed by Expr::self
+struct MatchScratch {
+    std::vector<uint8_t> active;
+    std::vector<size_t> start;
+    std::vector<size_t> size;
+    // Leaves already known to occur in the input, see admits_input
+    std::vector<uint8_t> present;
+    // The tree's atom classes, set by reset_scratch
+    const std::vector<CharClass>* atoms = nullptr;
+    // First input position of each byte in any leaf class, from optimize_parse_tree
+    BytePositions first_byte;
+    CharClass scanned;
+    MatchMemo memo;
+    // Shared cancellation flag, polled between product combos; null when never cancelled
+    std::atomic<bool>* stop = nullptr;
+    // EXISTS and FIRST set stop at the first complete match
+    MatchMode mode = MatchMode::ALL;
+    // Lazy DFA states for regular patterns; kept across inputs, see query_pattern
+    DfaCache dfa;
+};
+
+// Per-expr candidate counts of one match_up step, see plan_up
+struct UpPlan {
+    std::vector<std::vector<size_t>> expansions;
+    std::vector<size_t> group_indices;
+};
+
+// Odometer over the Cartesian product of expansions, visiting each choice vector in place
+// until visit returns false
+template <typename T, typename F>
+void for_each_product(const std::vector<std::vector<T>>& expansions, std::vector<T>& current, F&& visit) {
+    size_t depth = expansions.size();
+    std::vector<size_t> choice(depth, 0);
+    current.resize(depth);
+    for (size_t d = 0; d < depth; d++) {
+        if (expansions[d].empty()) return;
+        current[d] = expansions[d][0];
+    }
+    while (true) {
+        if (!visit(current)) return;
+        size_t d = depth;
+        while (d > 0) {
+            d--;
+            if (++choice[d] < expansions[d].size()) {
+                current[d] = expansions[d][choice[d]];
+                break;
+            }
+            choice[d] = 0;
+            current[d] = expansions[d][0];
+            if (d == 0) return;
+        }
+        if (depth == 0) return;
+    }
+}
+
+bool match_leaf(const CharClass& cls, std::string_view input, size_t pos);
 bool match_leaf(std::string_view leaf, std::string_view input, size_t pos);
-bool match(Expr& expr, const Equation& eq, const std::unordered_map<std::string, size_t>& sol, std::string_view input, size_t pos);
+bool match(const ExprTree& tree, const Expr& expr, const Equation& eq, const std::unordered_map<std::string, size_t>& sol, std::string_view input, size_t pos, const MatchScratch& scratch);
 
-void get_leaves(Expr& expr, std::vector<Expr*>& leaves);
+const RunTable& leaf_runs(const AtomString& leaf, const size_t N, const std::string_view input, MatchScratch& scratch);
+size_t first_match(const CharClass& cls, const MatchScratch& scratch);
+void get_leaves(const Expr& expr, std::vector<const Expr*>& leaves);
 void set_depths(Expr* node, size_t current_depth = 0);
-void optimize_parse_tree(Expr& expr, std::string_view input);
-void propagate_inactives(Expr& expr);
-void match_up(std::vector<std::tuple<Expr*, size_t, std::string>> exprs, std::vector<Expr*>& groups, const size_t N, const std::string_view input, std::vector<size_t> match, std::vector<std::vector<size_t>>& matches);
-void match_down(std::vector<Expr*> exprs, std::vector<Expr*>& groups, const size_t N, const std::string_view input, std::vector<std::vector<size_t>>& matches);
-void get_groups(Expr& expr, std::vector<Expr*>& groups);
+void reset_scratch(const ExprTree& tree, MatchScratch& scratch);
+void optimize_parse_tree(const Expr& expr, std::string_view input, MatchScratch& scratch);
+void propagate_inactives(const Expr& expr, MatchScratch& scratch);
+void match_up(std::vector<UpExpr> exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, std::vector<size_t> match, std::vector<std::vector<size_t>>& matches, MatchScratch& scratch);
+void match_down(std::vector<const Expr*> exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, std::vector<std::vector<size_t>>& matches, MatchScratch& scratch, MatchMode mode = MatchMode::ALL);
+bool stopped(const MatchScratch& scratch);
+bool halts_on_match(const MatchScratch& scratch);
+
+// One level of each search split into planning its product and visiting a single combo
+bool plan_up(const std::vector<UpExpr>& exprs, const size_t N, const std::string_view input, MatchScratch& scratch, UpPlan& plan);
+void collapse_up(const std::vector<UpExpr>& exprs, const UpPlan& plan, const std::vector<size_t>& current, std::vector<UpExpr>& collapsed);
+void visit_up(const std::vector<UpExpr>& exprs, const UpPlan& plan, const std::vector<size_t>& current, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, MatchScratch& scratch, std::vector<std::vector<size_t>>& result);
+const std::vector<std::vector<size_t>>& solve_up(const std::vector<UpExpr>& exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, MatchScratch& scratch);
+bool leaves_up(const std::vector<const Expr*>& exprs, const std::vector<const Expr*>& groups, const MatchScratch& scratch, std::vector<UpExpr>& exprs_up);
+void plan_down(const std::vector<const Expr*>& exprs, const MatchScratch& scratch, std::vector<std::vector<const Expr*>>& expansions);
+bool all_leaves(const std::vector<const Expr*>& exprs);
+const std::vector<std::vector<size_t>>& solve_down(const std::vector<const Expr*>& exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, MatchScratch& scratch);
+
+// Number of matches solve_down / solve_up would return, memoized by count alone
+size_t count_up(const std::vector<UpExpr>& exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, MatchScratch& scratch);
+size_t count_down(const std::vector<const Expr*>& exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, MatchScratch& scratch);
+void get_groups(const Expr& expr, std::vector<const Expr*>& groups);
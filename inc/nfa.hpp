@@ -0,0 +1,71 @@
+#pragma once
+
+#include "core.hpp"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+enum class NfaOp : uint8_t {
+    CLASS,
+    SPLIT,
+    EPSILON,
+    MATCH,
+    OPEN,
+    CLOSE,
+    REF,
+    RESET,
+    COUNT,
+    REPEAT,
+};
+
+// CLASS consumes one byte of classes[cls] and goes to out; SPLIT forks to out and
+// out1; EPSILON goes to out. OPEN/CLOSE record capture slot cls around a group, REF
+// consumes the text slot cls recorded last. RESET zeroes count slot cls on entering a
+// repetition and COUNT adds one per pass; REPEAT does the same for a loop, but refuses
+// a second pass beginning where the previous one did. Engines other than derive_counts
+// take the three as EPSILON
+struct NfaState {
+    NfaOp op = NfaOp::MATCH;
+    uint32_t cls = 0;
+    uint32_t out = no_node;
+    uint32_t out1 = no_node;
+};
+
+// Thompson automaton over byte classes, built from a parse tree with the same
+// concatenation/alternation grouping match_down uses
+struct Nfa {
+    std::vector<NfaState> states;
+    std::vector<CharClass> classes;
+    uint32_t start = 0;
+    // Bytes no class tells apart share one id; rep holds one byte per id
+    std::array<uint8_t, 256> byte_class{};
+    std::vector<uint8_t> rep;
+    // Captured node of each slot
+    std::vector<uint32_t> slot_node;
+    // Repeated node of each count slot
+    std::vector<uint32_t> count_node;
+    // Bytes a match can begin with, unless it can begin without consuming one
+    CharClass first;
+    bool starts_anywhere = false;
+    // Unique per compile_nfa call, so caches built for a freed automaton are never reused
+    uint64_t id = 0;
+};
+
+constexpr size_t max_nfa_states = 1 << 14;
+
+// Back-references, invalid nodes, or counted repetitions expanding past max_nfa_states
+// leave a pattern to the equation search; compile_nfa returns false for those
+bool is_regular(const ExprTree& tree);
+bool compile_nfa(const ExprTree& tree, Nfa& nfa);
+
+// Same automaton with capture and REF states. compile_ref_nfa gives slots only to the
+// groups some REF reads and fails without one; compile_capture_nfa gives every group
+// its slot, in the order of groups
+bool compile_ref_nfa(const ExprTree& tree, const std::vector<const Expr*>& groups, Nfa& nfa);
+bool compile_capture_nfa(const ExprTree& tree, const std::vector<const Expr*>& groups, Nfa& nfa);
+// compile_ref_nfa's automaton, with or without a REF, plus a count slot for every
+// repetition below the root, in the order of their x-vars
+bool compile_count_nfa(const ExprTree& tree, const std::vector<const Expr*>& groups, Nfa& nfa);
+
+// Next Nfa::id, for automata not built by the functions above
+uint64_t next_nfa_id();
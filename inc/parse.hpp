@@ -1,35 +1,32 @@
 #pragma once
 
 #include "core.hpp"
+#include "scan.hpp"
 #include <string_view>
-#include <memory>
+#include <vector>
 
-// Parsing entry point
-std::unique_ptr<Expr> parse(std::string_view input);
-std::unique_ptr<Expr> parse(std::string_view input, size_t& ref_id);
+// Parsing entry point; the group scanners and checkers are in scan.hpp
+ExprTree parse(std::string_view input);
+ExprTree parse(std::string_view input, size_t& ref_id);
+void parse(ExprTree& tree, uint32_t node, std::string_view input, size_t& ref_id);
 
-// Group scanning and classification
-GroupType check_group(std::string_view input);
-bool is_valid_group(GroupType group_type);
-bool is_wrapped(GroupType type);
-bool is_bracketed(GroupType type);
-
-// Group scanners
-std::string_view scan_group(std::string_view input, GroupType& type, size_t ref_id);
-std::string_view scan_group_implicit(std::string_view input);
-std::string_view scan_group_wrapped(std::string_view input, GroupType& type);
-std::string_view unwrap_group(std::string_view input);
-std::string_view scan_ref(std::string_view input, GroupType& type, size_t ref_id);
+bool is_ref(const Expr& expr);
+size_t ref_number(const Expr& expr);
+// False when a level was cut at a reference to a later group, or a reference names
+// no group at all, e.g. \0 or a \1 without groups
+bool refs_resolved(const ExprTree& tree);
 
 // Bracket handling
-std::string_view scan_bracket(std::string_view input, GroupType& type);
 std::string_view scan_bracket_inner(std::string_view input, GroupType& type);
 bool is_valid_bracket_class(std::string_view input);
 bool is_valid_bracket_collation(std::string_view input);
 bool is_valid_bracket_equivalence(std::string_view input);
-std::string_view scan_bracket_char(std::string_view input, GroupType& type);
-char eval_bracket_char(std::string_view input);
-
-// Misc scanning
-std::string_view scan_number(std::string_view input);
 
+// Char class compilation
+CharClass compile_escape(char esc);
+CharClass compile_posix_class(std::string_view name);
+CharClass compile_bracket(std::string_view input);
+CharClass compile_leaf(std::string_view leaf);
+void compile_atoms(std::string_view leaf, std::vector<CharClass>& atoms);
+// Fills tree.atoms and each leaf's atom range; back-references get none
+void index_atoms(ExprTree& tree);
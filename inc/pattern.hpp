@@ -0,0 +1,66 @@
+#pragma once
+
+#include "core.hpp"
+#include "matching.hpp"
+#include "literals.hpp"
+#include "nfa.hpp"
+#include "glushkov.hpp"
+#include "backref.hpp"
+#include "derive.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+// Input-independent result of parse + gen_frags + set_depths + get_groups.
+// Immutable once built, so one instance can be shared by any number of
+// threads, each matching with its own MatchScratch
+struct CompiledPattern {
+    std::string text;
+    ExprTree tree;
+    std::vector<const Expr*> groups;
+    std::vector<RequiredLiteral> literals;
+    // Set when the tree has no back-references; EXISTS queries then run on the
+    // bit-parallel automaton when it fits in a word, on a lazy DFA otherwise
+    bool regular = false;
+    Nfa nfa;
+    bool bit_parallel = false;
+    // Held apart, as its tables dwarf most patterns; null unless bit_parallel
+    std::unique_ptr<const Glushkov> glushkov;
+    // Set instead when the tree has back-references: nfa then also records the spans
+    // they read, and queries run ref_match
+    bool backrefs = false;
+    // Every group's span recorded, for search_pattern
+    bool searchable = false;
+    Nfa captures;
+    // Repetition counts tracked, for the FIRST, COUNT and ALL answers of regular and
+    // back-referencing patterns; unset when the counting automaton outgrows max_nfa_states
+    bool countable = false;
+    Nfa counts;
+};
+
+// Answer to one query_pattern call; matches is filled for FIRST (at most one) and ALL only
+struct MatchResult {
+    bool found = false;
+    size_t count = 0;
+    std::vector<std::vector<size_t>> matches;
+};
+
+// Compilation
+std::unique_ptr<const CompiledPattern> compile_pattern(std::string_view regex);
+// Everything compile_pattern derives from a tree that already has its frags, lengths
+// and depths: groups, literals and the automata
+void compile_engines(CompiledPattern& pattern);
+// Sets bit_parallel and glushkov from a regular nfa
+void compile_bit_parallel(CompiledPattern& pattern);
+// Memory held by the pattern, for bounding caches: every allocation it owns, the term
+// pools and all automata included. Lazy DFAs are built per MatchScratch and are not
+// the pattern's
+size_t pattern_bytes(const CompiledPattern& pattern);
+
+// Matching. Inputs of a length the pattern cannot produce, or lacking one of its
+// required literals, are rejected up front; prepare_scratch returns false for those
+// and leaves the tree unoptimized
+bool admits_input(const CompiledPattern& pattern, std::string_view input, MatchScratch& scratch);
+bool prepare_scratch(const CompiledPattern& pattern, std::string_view input, MatchScratch& scratch);
+MatchResult query_pattern(const CompiledPattern& pattern, std::string_view input, MatchScratch& scratch, MatchMode mode);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "pattern.hpp"
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Thread-safe cache of compiled patterns keyed by regex text, evicting the least
+// recently used once the patterns' pattern_bytes exceed max_bytes (the newest entry is
+// always kept). Patterns are shared, so evicting one never frees it under a caller.
+// Compilation runs outside the lock; two threads missing on the same regex may both
+// compile it, and the first to finish is kept
+struct PatternCache {
+    explicit PatternCache(size_t max_bytes);
+
+    PatternCache(const PatternCache&) = delete;
+    PatternCache& operator=(const PatternCache&) = delete;
+
+    // Null when regex fails to parse; failures are not cached
+    std::shared_ptr<const CompiledPattern> get(std::string_view regex);
+
+    size_t hits() const;
+    size_t misses() const;
+    size_t size() const;
+    size_t bytes() const;
+
+private:
+    struct Entry {
+        std::string regex;
+        std::shared_ptr<const CompiledPattern> pattern;
+        size_t bytes = 0;
+    };
+
+    void evict();
+
+    mutable std::mutex mutex;
+    // Most recently used first; index keys view the regex strings held here
+    std::list<Entry> order;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+    size_t max_bytes;
+    size_t used_bytes = 0;
+    std::atomic<size_t> hit_count{0};
+    std::atomic<size_t> miss_count{0};
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "pattern.hpp"
+#include "pattern_cache.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Many patterns compiled together. Their required literals share one Aho-Corasick
+// automaton, so an input is scanned once and only the patterns whose literals all
+// occur in it, or that have none, go on to their own engine
+struct PatternSet {
+    std::vector<std::shared_ptr<const CompiledPattern>> patterns;
+    LiteralAutomaton literals;
+    // Per literal id, the patterns requiring it
+    std::vector<std::vector<uint32_t>> owners;
+    // Per pattern, the number of distinct literals it requires
+    std::vector<uint32_t> required;
+    // Patterns requiring no literal
+    std::vector<uint32_t> unfiltered;
+    // Distinct per built set, even one reusing a freed set's address
+    uint64_t serial = 0;
+};
+
+// Per-thread state of match_set; sized for the set it last ran on, and reset
+// whenever it is given another
+struct PatternSetScratch {
+    uint64_t set_serial = 0;
+    MatchScratch match;
+    // One lazy DFA per pattern, swapped into match while that pattern runs, so each
+    // keeps the states it built across inputs
+    std::vector<DfaCache> dfas;
+    std::vector<uint8_t> reported;
+    std::vector<uint32_t> found;
+    // Per pattern, how many of its literals were found
+    std::vector<uint32_t> hits;
+    std::vector<uint32_t> candidates;
+};
+
+// Null when any regex fails to parse; pattern ids are indices into regexes. Patterns
+// come from cache when one is given, so sets sharing regexes compile them once
+std::unique_ptr<const PatternSet> compile_pattern_set(const std::vector<std::string>& regexes, PatternCache* cache = nullptr);
+// Same, from patterns already compiled or loaded
+std::unique_ptr<const PatternSet> build_pattern_set(std::vector<std::shared_ptr<const CompiledPattern>> patterns);
+// Ids, ascending, of the patterns matching the whole input, as EXISTS queries would
+void match_set(const PatternSet& set, std::string_view input, PatternSetScratch& scratch, std::vector<uint32_t>& ids);
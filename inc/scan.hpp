@@ -0,0 +1,379 @@
+#pragma once
+
+#include "core.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+
+// Token scanners and char class builders shared by parse and the compile-time path in
+// static_regex.hpp, so they are constexpr and avoid <cctype> and <charconv>. Byte
+// classes follow the C locale
+
+constexpr bool is_digit(size_t c) { return c >= '0' && c <= '9'; }
+constexpr bool is_upper(size_t c) { return c >= 'A' && c <= 'Z'; }
+constexpr bool is_lower(size_t c) { return c >= 'a' && c <= 'z'; }
+constexpr bool is_alpha(size_t c) { return is_upper(c) || is_lower(c); }
+constexpr bool is_alnum(size_t c) { return is_alpha(c) || is_digit(c); }
+constexpr bool is_xdigit(size_t c) { return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+constexpr bool is_space(size_t c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+constexpr bool is_blank(size_t c) { return c == ' ' || c == '\t'; }
+constexpr bool is_cntrl(size_t c) { return c < 32 || c == 127; }
+constexpr bool is_graph(size_t c) { return c > 32 && c < 127; }
+constexpr bool is_print(size_t c) { return c >= 32 && c < 127; }
+constexpr bool is_punct(size_t c) { return is_graph(c) && !is_alnum(c); }
+
+constexpr bool is_digit(char c) { return is_digit(static_cast<size_t>(static_cast<unsigned char>(c))); }
+constexpr bool is_xdigit(char c) { return is_xdigit(static_cast<size_t>(static_cast<unsigned char>(c))); }
+
+// Leading digits of input in base 10 or 16; like std::from_chars, n is left untouched
+// when there are none or they overflow
+constexpr bool read_count(std::string_view input, size_t& n, size_t base = 10) {
+    size_t value = 0;
+    size_t i = 0;
+    for (; i < input.size(); i++) {
+        char c = input[i];
+        size_t digit = is_digit(c) ? c - '0' : (base == 16 && is_xdigit(c)) ? (c | 0x20) - 'a' + 10 : base;
+        if (digit >= base) break;
+        if (value > (unbounded - digit) / base) return false;
+        value = value * base + digit;
+    }
+    if (i == 0) return false;
+    n = value;
+    return true;
+}
+
+constexpr std::string_view scan_number(std::string_view input) {
+    size_t i = 0;
+    while (i < input.size() && is_digit(input[i])) i++;
+    return input.substr(0, i);
+}
+
+// Group classification
+
+constexpr bool is_valid_group(GroupType type) {
+    return type == GroupType::IMPLICIT ||
+           type == GroupType::CAPTURE ||
+           type == GroupType::NONCAPTURE ||
+           type == GroupType::BRACKET ||
+           type == GroupType::BRACKET_NEGATED;
+}
+
+constexpr GroupType check_group(std::string_view input) {
+    if (input.empty()) return GroupType::EMPTY;
+    auto c1 = input[0];
+    auto c2 = input.size() > 1 ? input[1] : '\0';
+    auto c3 = input.size() > 2 ? input[2] : '\0';
+    if (std::string_view("{|?*+").contains(c1)) return GroupType::INVALID_GROUP_START;
+    if (c1 == '(') return (c2 == '?' && c3 == ':') ? GroupType::NONCAPTURE : GroupType::CAPTURE;
+    if (c1 == '[') return (c2 == '^') ? GroupType::BRACKET_NEGATED : GroupType::BRACKET;
+    if (c1 == '\\' && is_digit(c2)) return GroupType::REF;
+    return GroupType::IMPLICIT;
+}
+
+constexpr bool is_wrapped(GroupType type) {
+    return type == GroupType::CAPTURE || type == GroupType::NONCAPTURE;
+}
+
+constexpr bool is_bracketed(GroupType type) {
+    return type == GroupType::BRACKET || type == GroupType::BRACKET_NEGATED;
+}
+
+// Group scanners
+
+constexpr std::string_view scan_bracket(std::string_view input, GroupType& type) {
+    constexpr std::string_view special = ":.=";
+    auto end_it = std::adjacent_find(input.begin(), input.end(), [=](char a, char b) { return !special.contains(a) && b == ']'; });
+    bool closed = (end_it != input.end());
+    if (!closed) {
+        type = GroupType::INVALID_BRACKET_UNMATCHED;
+        return "";
+    }
+    ++end_it;
+    size_t end_pos = std::distance(input.begin(), end_it + 1);
+    return input.substr(0, end_pos);
+}
+
+constexpr std::string_view scan_bracket_char(std::string_view input, GroupType& type) {
+    if (input.empty()) return "";
+    if (input[0] != '\\') return input.substr(0, 1);
+    if (input.size() < 2) {
+        type = GroupType::INVALID_BRACKET_ESCAPE;
+        return "";
+    }
+    if (input.substr(0, 2) != "\\x") return input.substr(0, 2);
+    if (input.size() < 4) {
+        type = GroupType::INVALID_BRACKET_HEX;
+        return "";
+    }
+    auto hex = input.substr(2, 2);
+    if (!is_xdigit(hex[0]) || !is_xdigit(hex[1])) {
+        type = GroupType::INVALID_BRACKET_HEX;
+        return "";
+    }
+    return input.substr(0, 4);
+}
+
+constexpr char eval_bracket_char(std::string_view input) {
+    if (input.empty()) return '\0';
+    if (input.substr(0, 2) == "\\x") {
+        size_t c = 0;
+        read_count(input.substr(2, 2), c, 16);
+        return static_cast<char>(c);
+    }
+    if (input[0] == '\\') {
+        switch (input[1]) {
+            case 't': return '\t';
+            case 'n': return '\n';
+            case 'r': return '\r';
+            case 'f': return '\f';
+            case 'v': return '\v';
+            case 'a': return '\a';
+            case 'b': return '\b';
+            case '\\': return '\\';
+            case '\'': return '\'';
+            case '"': return '"';
+            default: return input[1];
+        }
+    }
+    return input[0];
+}
+
+constexpr std::string_view scan_atom(std::string_view input) {
+    if (input.empty()) return "";
+    GroupType type = GroupType::IMPLICIT;
+    if (input[0] == '[') {
+        auto atom = scan_bracket(input, type);
+        return atom.empty() ? input.substr(0, 1) : atom;
+    }
+    if (input[0] != '\\' || input.size() < 2) return input.substr(0, 1);
+    if (is_digit(input[1])) return input.substr(0, 1 + scan_number(input.substr(1)).size());
+    auto atom = scan_bracket_char(input, type);
+    return atom.empty() ? input.substr(0, 2) : atom;
+}
+
+constexpr std::string_view scan_group_implicit(std::string_view input) {
+    constexpr std::string_view end = "(){|?*+";
+    constexpr std::string_view split = "?*+{";
+    size_t pos = 0;
+    size_t last = 0;
+    while (pos < input.size() && !end.contains(input[pos])) {
+        if (input[pos] == '\\' && pos + 1 < input.size() && is_digit(input[pos + 1]) && pos > 0) break;
+        last = pos;
+        pos += scan_atom(input.substr(pos)).size();
+    }
+    if (pos >= input.size()) return input;
+    return input.substr(0, (split.contains(input[pos]) && last > 0) ? last : pos);
+}
+
+constexpr std::string_view scan_group_wrapped(std::string_view input, GroupType& type) {
+    int balance = 0;
+    size_t i = 0;
+    for (; i < input.size(); i++) {
+        if (input[i] == '(') balance++;
+        else if (input[i] == ')') balance--;
+        if (balance == 0) break;
+    }
+    if (balance != 0) {
+        type = GroupType::INVALID_GROUP_UNMATCHED;
+        return "";
+    }
+    return input.substr(0, i + 1);
+}
+
+constexpr std::string_view unwrap_group(std::string_view input) {
+    return (input.size() >= 2) ? input.substr(1, input.size() - 2) : "";
+}
+
+constexpr std::string_view scan_ref(std::string_view input, GroupType& type, size_t ref_id) {
+    auto num = scan_number(input.substr(1));
+    size_t n = unbounded;
+    read_count(num, n);
+    if (n > ref_id) {
+        type = GroupType::INVALID_REF_ID;
+        return "";
+    }
+    return input.substr(0, 1 + num.size());
+}
+
+constexpr std::string_view scan_group(std::string_view input, GroupType& type, size_t ref_id) {
+    type = check_group(input);
+    if (type == GroupType::REF) return scan_ref(input, type, ref_id);
+    if (is_bracketed(type)) return scan_bracket(input, type);
+    if (is_wrapped(type)) return scan_group_wrapped(input, type);
+    return scan_group_implicit(input);
+}
+
+// Op and link checkers
+
+constexpr OpType check_op(std::string_view input) {
+    if (input.empty()) return OpType::ONE;
+    char c = input[0];
+    switch (c) {
+        case '?': return OpType::ZERO_OR_ONE;
+        case '*': return OpType::ZERO_OR_MORE;
+        case '+': return OpType::ONE_OR_MORE;
+        case '{': {
+            auto end = input.find('}');
+            if (end == std::string_view::npos) return OpType::INVALID_REPETITION_UNMATCHED;
+            auto content = input.substr(1, end - 1);
+            if (!std::all_of(content.begin(), content.end(), [](char ch){ return is_digit(ch) || ch == ','; }))
+                return OpType::INVALID_REPETITION_CHAR;
+            if (std::count(content.begin(), content.end(), ',') > 1)
+                return OpType::INVALID_REPETITION_COMMA_MORE_THAN_ONE;
+
+            size_t comma_pos = content.find(',');
+            if (comma_pos == std::string_view::npos) return OpType::N;
+            if (comma_pos == 0) return OpType::M_OR_LESS;
+            if (comma_pos == content.size() - 1) return OpType::N_OR_MORE;
+
+            size_t n = 0, m = 0;
+            read_count(content.substr(0, comma_pos), n);
+            read_count(content.substr(comma_pos + 1), m);
+            return (n < m) ? OpType::N_M : OpType::INVALID_REPETITION_M_LTE_N;
+        }
+    }
+    return OpType::NONE;
+}
+
+constexpr LinkType check_link(std::string_view input) {
+    if (input.empty()) return LinkType::NONE;
+    if (input[0] == '|') return (input.size() == 1) ? LinkType::INVALID_ALTERNATION_RHS_EMPTY : LinkType::ALTERNATION;
+    return LinkType::CONCATENATION;
+}
+
+constexpr bool is_valid_repetition(OpType op_type) {
+    return op_type == OpType::N ||
+           op_type == OpType::N_OR_MORE ||
+           op_type == OpType::M_OR_LESS ||
+           op_type == OpType::N_M;
+}
+
+constexpr bool is_valid_op(OpType op_type) {
+    return op_type == OpType::NONE ||
+           op_type == OpType::ONE ||
+           op_type == OpType::ZERO_OR_ONE ||
+           op_type == OpType::ZERO_OR_MORE ||
+           op_type == OpType::ONE_OR_MORE ||
+           is_valid_repetition(op_type);
+}
+
+constexpr bool is_valid_link(LinkType link_type) {
+    return link_type == LinkType::CONCATENATION ||
+           link_type == LinkType::ALTERNATION;
+}
+
+// Scanners that consume op/link tokens
+
+constexpr std::string_view scan_op(std::string_view input, OpType& op_type) {
+    op_type = check_op(input);
+    if (op_type == OpType::ZERO_OR_ONE ||
+        op_type == OpType::ZERO_OR_MORE ||
+        op_type == OpType::ONE_OR_MORE) {
+        return input.substr(0, 1);
+    } else if (is_valid_repetition(op_type)) {
+        return input.substr(0, input.find('}') + 1);
+    }
+    return "";
+}
+
+constexpr std::string_view scan_link(std::string_view input, LinkType& link_type) {
+    link_type = check_link(input);
+    if (link_type == LinkType::ALTERNATION) return input.substr(0, 1);
+    return "";
+}
+
+// Char class builders, over any set type with set(byte), |= and ~ (CharClass at run
+// time, StaticClass at compile time)
+
+template <class Class>
+constexpr Class escape_class(char esc) {
+    Class cls;
+    for (size_t c = 0; c < 256; c++) {
+        bool in = false;
+        switch (esc) {
+            case 'd': case 'D': in = is_digit(c); break;
+            case 'w': case 'W': in = is_alnum(c) || c == '_'; break;
+            case 's': case 'S': in = is_space(c); break;
+            default: break;
+        }
+        if (in) cls.set(c);
+    }
+    return is_upper(static_cast<unsigned char>(esc)) ? ~cls : cls;
+}
+
+template <class Class>
+constexpr Class posix_class(std::string_view name) {
+    Class cls;
+    for (size_t c = 0; c < 256; c++) {
+        bool in = false;
+        if (name == "upper") in = is_upper(c);
+        else if (name == "lower") in = is_lower(c);
+        else if (name == "alpha") in = is_alpha(c);
+        else if (name == "digit") in = is_digit(c);
+        else if (name == "xdigit") in = is_xdigit(c);
+        else if (name == "alnum") in = is_alnum(c);
+        else if (name == "punct") in = is_punct(c);
+        else if (name == "blank") in = is_blank(c);
+        else if (name == "space") in = is_space(c);
+        else if (name == "cntrl") in = is_cntrl(c);
+        else if (name == "graph") in = is_graph(c);
+        else if (name == "print") in = is_print(c);
+        if (in) cls.set(c);
+    }
+    return cls;
+}
+
+template <class Class>
+constexpr Class bracket_class(std::string_view input) {
+    GroupType type = GroupType::BRACKET;
+    auto bracket = scan_bracket(input, type);
+    if (bracket.size() < 2) return {};
+    auto content = bracket.substr(1, bracket.size() - 2);
+    bool negated = !content.empty() && content[0] == '^';
+    if (negated) content.remove_prefix(1);
+
+    Class cls;
+    while (!content.empty()) {
+        if (content.starts_with("[:")) {
+            size_t end = content.find(":]");
+            if (end == std::string_view::npos) break;
+            cls |= posix_class<Class>(content.substr(2, end - 2));
+            content.remove_prefix(end + 2);
+            continue;
+        }
+        auto lo = scan_bracket_char(content, type);
+        if (lo.empty()) break;
+        content.remove_prefix(lo.size());
+        bool is_class = lo.size() == 2 && std::string_view("dDwWsS").contains(lo[1]);
+        if (is_class) {
+            cls |= escape_class<Class>(lo[1]);
+            continue;
+        }
+        unsigned char first = eval_bracket_char(lo);
+        if (content.size() > 1 && content[0] == '-') {
+            auto hi = scan_bracket_char(content.substr(1), type);
+            unsigned char last = eval_bracket_char(hi);
+            content.remove_prefix(1 + hi.size());
+            for (size_t c = first; c <= last; c++) cls.set(c);
+            continue;
+        }
+        cls.set(first);
+    }
+    return negated ? ~cls : cls;
+}
+
+// Class of one atom, as scan_atom splits a leaf
+template <class Class>
+constexpr Class leaf_class(std::string_view leaf) {
+    Class cls;
+    if (leaf.empty()) return cls;
+    if (leaf[0] == '[') return bracket_class<Class>(leaf);
+    if (leaf[0] == '\\') {
+        if (leaf.size() < 2 || is_digit(leaf[1])) return cls;
+        if (std::string_view("dDwWsS").contains(leaf[1])) return escape_class<Class>(leaf[1]);
+        cls.set(static_cast<unsigned char>(eval_bracket_char(scan_atom(leaf))));
+        return cls;
+    }
+    cls.set(static_cast<unsigned char>(leaf[0]));
+    return cls;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "pattern.hpp"
+#include <string_view>
+#include <vector>
+
+struct Span {
+    size_t start = unbounded;
+    size_t end = unbounded;
+};
+
+// One occurrence in a searched buffer; groups follows CompiledPattern::groups, with
+// unbounded spans for groups that did not take part
+struct SearchMatch {
+    Span span;
+    std::vector<Span> groups;
+};
+
+enum class SearchMode : size_t {
+    LONGEST,
+    ALL,
+};
+
+// Unanchored search. LONGEST reports the leftmost-longest match, ALL every
+// non-overlapping leftmost-longest match from left to right. One find_matches pass
+// covers every start position and every match, so no byte is scanned twice; buffers
+// lacking a required literal are rejected up front
+bool search_pattern(const CompiledPattern& pattern, std::string_view buffer, SearchMode mode, std::vector<SearchMatch>& matches);
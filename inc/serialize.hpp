@@ -0,0 +1,26 @@
+#pragma once
+
+#include "pattern.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Binary form of a compiled pattern: a header (magic, format version, byte order,
+// size), the regex text, one fixed-width record per node with its views stored as
+// offsets into the text, the leaf atom classes, the nodes' variables, fragment ranges
+// and length sets, the fragment term pools, the engine flags and the automata, the
+// bit-parallel tables the positions use, then the required literals. Records may be
+// concatenated.
+// Loading allocates each array once, none per node, and runs neither parse, gen_frags
+// nor any engine construction; only the group pointers are rederived
+constexpr uint32_t pattern_format_version = 5;
+
+// Appends pattern to out
+void write_pattern(const CompiledPattern& pattern, std::string& out);
+// Null when data does not start with a well-formed record of this version and byte
+// order; otherwise used is the record's size
+std::unique_ptr<const CompiledPattern> read_pattern(std::string_view data, size_t& used);
+bool is_pattern_data(std::string_view data);
+// Every record of data, in order; false when any is malformed
+bool read_patterns(std::string_view data, std::vector<std::shared_ptr<const CompiledPattern>>& patterns);
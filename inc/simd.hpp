@@ -0,0 +1,18 @@
+#pragma once
+
+#include "core.hpp"
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+// Byte and substring search over raw input. On x86 these use AVX2 when the CPU has
+// it and SSE2 otherwise; elsewhere they fall back to the standard library.
+// Both return std::string_view::npos when there is no hit at or after from
+size_t find_byte(std::string_view haystack, char byte, size_t from = 0);
+size_t find_bytes(std::string_view haystack, std::string_view needle, size_t from = 0);
+
+// First position of every wanted byte; npos when absent and for the bytes not wanted.
+// The scan stops as soon as all of them have been seen. More than a few bytes are tested
+// 32 at a time with AVX2 nibble lookups, and one at a time without AVX2
+using BytePositions = std::array<size_t, 256>;
+void first_positions(std::string_view input, const CharClass& wanted, BytePositions& first);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "core.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <limits>
+
+// Native solver for the length system emitted by gen_frags / collect_b_eqs
+
+struct SolverTerm {
+    size_t coeff;
+    std::vector<size_t> vars;
+};
+
+struct SolverConstraint {
+    std::vector<SolverTerm> terms;
+    RelType rel;
+    size_t rhs;
+};
+
+// Constraints with variables resolved to dense indices
+struct SolverSystem {
+    std::vector<Var> vars;
+    std::vector<SolverConstraint> constraints;
+};
+
+// System construction
+size_t add_solver_var(SolverSystem& sys, const Var& var);
+SolverSystem compile_system(const std::vector<Constraint>& system);
+SolverSystem parse_system(const std::string& equation);
+SolverSystem build_system(const ExprTree& tree, size_t input_size);
+
+// Enumeration
+std::vector<std::unordered_map<std::string, size_t>> solve_system(const SolverSystem& sys, size_t limit = std::numeric_limits<size_t>::max());
@@ -0,0 +1,323 @@
+#pragma once
+
+#include "scan.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Compile-time patterns: static_match<"[a-z]+@x\\.com">(input) parses the regex with
+// the scanners of scan.hpp while the program is compiled, and matches with tables baked
+// into the binary. Same whole-input answer as query_pattern's EXISTS mode; patterns
+// that are not regular or need more than max_static_positions positions fail to compile,
+// and static_pattern<Regex> tells them apart beforehand
+
+// Byte set usable in constant expressions, which std::bitset is not before libstdc++ 13
+struct StaticClass {
+    std::array<uint64_t, 4> words{};
+
+    constexpr void set(size_t c) { words[c / 64] |= uint64_t{1} << (c % 64); }
+    constexpr bool test(size_t c) const { return (words[c / 64] >> (c % 64)) & 1; }
+    constexpr size_t count() const {
+        size_t total = 0;
+        for (auto w : words) total += std::popcount(w);
+        return total;
+    }
+    constexpr StaticClass& operator|=(const StaticClass& other) {
+        for (size_t i = 0; i < words.size(); i++) words[i] |= other.words[i];
+        return *this;
+    }
+    constexpr StaticClass operator~() const {
+        StaticClass cls;
+        for (size_t i = 0; i < words.size(); i++) cls.words[i] = ~words[i];
+        return cls;
+    }
+};
+
+// String literal as a template argument
+template <size_t N>
+struct FixedString {
+    char text[N]{};
+
+    constexpr FixedString(const char (&s)[N]) { std::copy_n(s, N, text); }
+    constexpr std::string_view view() const { return {text, N - 1}; }
+};
+
+constexpr size_t max_static_positions = 63;
+
+// Position automaton in the layout of Glushkov, bit 0 being the start
+struct StaticAutomaton {
+    bool regular = false;
+    bool fits = false;
+    size_t positions = 0;
+    std::array<uint64_t, max_static_positions + 1> follow{};
+    std::array<uint64_t, 256> byte_mask{};
+    uint64_t accept = 0;
+    // Set when the pattern matches only the text of its positions, one byte each
+    bool literal = false;
+    std::array<char, max_static_positions> text{};
+};
+
+// The fields of Expr that the automaton is built from
+struct StaticNode {
+    GroupType group_type = GroupType::IMPLICIT;
+    OpType op_type = OpType::ONE;
+    LinkType link_type = LinkType::NONE;
+    std::string_view group;
+    std::string_view op;
+    size_t n = 0;
+    size_t m = 0;
+    uint32_t first_child = no_node;
+    uint32_t child_count = 0;
+};
+
+// Mirrors parse, including the cut of a level at its first REF to a later group
+constexpr void static_parse(std::vector<StaticNode>& nodes, uint32_t node, std::string_view input, size_t& ref_id) {
+    GroupType group_type;
+    OpType op_type;
+    LinkType link_type;
+    auto scan = scan_group(input, group_type, unbounded);
+    auto rest = input.substr(scan.size());
+    auto op = scan_op(rest, op_type);
+    auto link = scan_link(rest.substr(op.size()), link_type);
+
+    bool wrapped = is_wrapped(group_type);
+    if (!wrapped && scan.size() == input.size()) {
+        nodes[node] = {group_type, OpType::NONE, LinkType::NONE, input, ""};
+        return;
+    } else if (wrapped && scan.size() + op.size() == input.size()) {
+        nodes[node] = {group_type, op_type, LinkType::NONE, scan, op};
+    } else {
+        nodes[node] = {GroupType::IMPLICIT, OpType::ONE, LinkType::NONE, input, ""};
+    }
+
+    std::vector<StaticNode> tokens;
+    while (!scan.empty()) {
+        tokens.push_back({group_type, op_type, link_type, scan, op});
+        rest.remove_prefix(op.size() + link.size());
+        scan = scan_group(rest, group_type, unbounded);
+        rest = rest.substr(scan.size());
+        op = scan_op(rest, op_type);
+        link = scan_link(rest.substr(op.size()), link_type);
+    }
+
+    auto first = static_cast<uint32_t>(nodes.size());
+    nodes.resize(nodes.size() + tokens.size());
+    nodes[node].first_child = first;
+    nodes[node].child_count = static_cast<uint32_t>(tokens.size());
+    for (uint32_t idx = 0; idx < tokens.size(); idx++) {
+        auto token = tokens[idx];
+        if (token.group_type == GroupType::REF) {
+            GroupType checked = token.group_type;
+            scan_ref(token.group, checked, ref_id);
+            if (checked == GroupType::INVALID_REF_ID) {
+                nodes[node].child_count = idx;
+                break;
+            }
+        }
+        if (token.group_type == GroupType::CAPTURE) ref_id++;
+        if (is_wrapped(token.group_type)) token.group = unwrap_group(token.group);
+        static_parse(nodes, first + idx, token.group, ref_id);
+        auto& lhs = nodes[first + idx];
+        lhs.group_type = token.group_type;
+        lhs.op_type = token.op_type;
+        lhs.link_type = token.link_type;
+        lhs.group = token.group;
+        lhs.op = token.op;
+    }
+}
+
+// Same ranges as set_range
+constexpr void static_range(StaticNode& node) {
+    auto op = node.op.empty() ? node.op : node.op.substr(1);
+    switch (node.op_type) {
+        case OpType::ZERO_OR_ONE: node.n = 0; node.m = 1; break;
+        case OpType::ZERO_OR_MORE: node.n = 0; node.m = unbounded; break;
+        case OpType::ONE_OR_MORE: node.n = 1; node.m = unbounded; break;
+        case OpType::N: read_count(op, node.n); node.m = node.n; break;
+        case OpType::N_OR_MORE: read_count(op, node.n); node.m = unbounded; break;
+        case OpType::M_OR_LESS: node.n = 0; read_count(op.substr(1), node.m); break;
+        case OpType::N_M: {
+            size_t comma_pos = op.find(',');
+            read_count(op.substr(0, comma_pos), node.n);
+            read_count(op.substr(comma_pos + 1), node.m);
+            break;
+        }
+        default: break;
+    }
+}
+
+// Same test as is_regular, node by node
+constexpr bool static_regular(const StaticNode& node) {
+    bool group = is_valid_group(node.group_type) || node.group_type == GroupType::EMPTY;
+    bool link = is_valid_link(node.link_type) || node.link_type == LinkType::NONE;
+    if (!group || !link || !is_valid_op(node.op_type)) return false;
+    bool leaf = node.child_count == 0;
+    return !(leaf && check_group(node.group) == GroupType::REF && 1 + scan_number(node.group.substr(1)).size() == node.group.size());
+}
+
+// First and last positions of a subexpression, and whether it matches the empty string
+struct StaticFrag {
+    uint64_t first = 0;
+    uint64_t last = 0;
+    bool nullable = true;
+};
+
+struct StaticBuild {
+    const std::vector<StaticNode>& nodes;
+    StaticAutomaton& automaton;
+    std::vector<StaticClass> classes;
+};
+
+constexpr void add_follow(StaticBuild& build, uint64_t from, uint64_t to) {
+    for (; from; from &= from - 1) build.automaton.follow[std::countr_zero(from)] |= to;
+}
+
+constexpr StaticFrag static_concat(StaticBuild& build, StaticFrag a, StaticFrag b) {
+    add_follow(build, a.last, b.first);
+    return {a.first | (a.nullable ? b.first : 0), b.last | (b.nullable ? a.last : 0), a.nullable && b.nullable};
+}
+
+constexpr StaticFrag static_loop(StaticBuild& build, StaticFrag a, bool nullable) {
+    add_follow(build, a.last, a.first);
+    return {a.first, a.last, nullable || a.nullable};
+}
+
+constexpr StaticFrag static_frag(StaticBuild& build, const StaticNode& node, bool apply_op);
+
+// Mirrors build_inner: children concatenate, a run of alternation links picks one member
+constexpr StaticFrag static_inner(StaticBuild& build, const StaticNode& node) {
+    auto& automaton = build.automaton;
+    if (node.child_count == 0) {
+        StaticFrag frag;
+        for (auto leaf = node.group; !leaf.empty() && automaton.fits;) {
+            auto atom = scan_atom(leaf);
+            leaf.remove_prefix(atom.size());
+            if (automaton.positions == max_static_positions) {
+                automaton.fits = false;
+                break;
+            }
+            size_t p = ++automaton.positions;
+            build.classes.push_back(leaf_class<StaticClass>(atom));
+            frag = static_concat(build, frag, {uint64_t{1} << p, uint64_t{1} << p, false});
+        }
+        return frag;
+    }
+    StaticFrag frag;
+    StaticFrag alt_run;
+    bool alt = false;
+    for (uint32_t i = 0; i < node.child_count && automaton.fits; i++) {
+        const auto& ch = build.nodes[node.first_child + i];
+        bool prev_alt = alt;
+        alt = (ch.link_type == LinkType::ALTERNATION);
+        auto ch_frag = static_frag(build, ch, true);
+        if (prev_alt) {
+            alt_run = {alt_run.first | ch_frag.first, alt_run.last | ch_frag.last, alt_run.nullable || ch_frag.nullable};
+        } else {
+            alt_run = ch_frag;
+        }
+        if (alt) continue;
+        frag = static_concat(build, frag, alt_run);
+    }
+    if (alt) frag = static_concat(build, frag, alt_run);
+    return frag;
+}
+
+// Mirrors build_frag: n copies, then m - n nested optionals or a loop
+constexpr StaticFrag static_frag(StaticBuild& build, const StaticNode& node, bool apply_op) {
+    if (!apply_op || node.op_type == OpType::NONE || node.op_type == OpType::ONE) return static_inner(build, node);
+    size_t n = node.n;
+    size_t m = node.m;
+    StaticFrag frag;
+    if (m == 0) return frag;
+    auto& automaton = build.automaton;
+    for (size_t i = 0; i + 1 < n && automaton.fits; i++) {
+        frag = static_concat(build, frag, static_inner(build, node));
+    }
+    if (m == unbounded) return static_concat(build, frag, static_loop(build, static_inner(build, node), n == 0));
+    if (n > 0) frag = static_concat(build, frag, static_inner(build, node));
+    StaticFrag tail;
+    for (size_t i = n; i < m && automaton.fits; i++) {
+        tail = static_concat(build, static_inner(build, node), tail);
+        tail.nullable = true;
+    }
+    return static_concat(build, frag, tail);
+}
+
+// Single bytes of positions 1.. chained one after the other
+constexpr bool find_literal(StaticAutomaton& automaton, const std::vector<StaticClass>& classes) {
+    size_t count = automaton.positions;
+    if (automaton.accept != uint64_t{1} << count) return false;
+    for (size_t p = 0; p < count; p++) {
+        const auto& cls = classes[p];
+        if (automaton.follow[p] != uint64_t{1} << (p + 1) || cls.count() != 1) return false;
+        size_t byte = 0;
+        while (!cls.test(byte)) byte++;
+        automaton.text[p] = static_cast<char>(byte);
+    }
+    return automaton.follow[count] == 0;
+}
+
+constexpr StaticAutomaton compile_static(std::string_view regex) {
+    StaticAutomaton automaton;
+    std::vector<StaticNode> nodes(1);
+    size_t ref_id = 0;
+    static_parse(nodes, 0, regex, ref_id);
+    for (auto& node : nodes) {
+        if (!static_regular(node)) return automaton;
+        static_range(node);
+    }
+    automaton.regular = true;
+    automaton.fits = true;
+
+    // The root's op is also carried by its only child, see build_nfa
+    StaticBuild build{nodes, automaton, {}};
+    auto frag = static_frag(build, nodes[0], false);
+    if (!automaton.fits) return automaton;
+    automaton.follow[0] = frag.first;
+    automaton.accept = frag.last | (frag.nullable ? 1 : 0);
+    for (size_t p = 0; p < build.classes.size(); p++) {
+        for (size_t b = 0; b < 256; b++) {
+            if (build.classes[p].test(b)) automaton.byte_mask[b] |= uint64_t{1} << (p + 1);
+        }
+    }
+    automaton.literal = find_literal(automaton, build.classes);
+    return automaton;
+}
+
+template <FixedString Regex>
+constexpr StaticAutomaton static_automaton = compile_static(Regex.view());
+
+// Patterns static_match takes, so code can test one without failing to compile
+template <FixedString Regex>
+concept static_pattern = static_automaton<Regex>.regular && static_automaton<Regex>.fits;
+
+template <FixedString Regex>
+struct StaticPattern {
+    static constexpr const StaticAutomaton& automaton = static_automaton<Regex>;
+    static_assert(automaton.regular, "static patterns cannot have back-references or invalid syntax");
+    static_assert(automaton.fits, "static pattern needs more than max_static_positions positions");
+
+    static constexpr bool match(std::string_view input) {
+        if constexpr (automaton.literal) {
+            return input == std::string_view(automaton.text.data(), automaton.positions);
+        } else {
+            uint64_t active = 1;
+            for (unsigned char c : input) {
+                uint64_t next = 0;
+                for (uint64_t bits = active; bits; bits &= bits - 1) next |= automaton.follow[std::countr_zero(bits)];
+                active = next & automaton.byte_mask[c];
+                if (!active) return false;
+            }
+            return (active & automaton.accept) != 0;
+        }
+    }
+};
+
+template <FixedString Regex>
+    requires static_pattern<Regex>
+constexpr bool static_match(std::string_view input) {
+    return StaticPattern<Regex>::match(input);
+}
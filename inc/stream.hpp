@@ -0,0 +1,50 @@
+#pragma once
+
+#include "search.hpp"
+#include <list>
+#include <string_view>
+#include <vector>
+
+struct StreamThread {
+    uint32_t state = no_node;
+    size_t start = 0;
+};
+
+// One leftmost-longest search, seeding a thread per byte from from until it finds a
+// match. followers are the final matches of the searches that started after this one's
+// match and have ended
+struct StreamLevel {
+    size_t from = 0;
+    bool found = false;
+    Span best;
+    std::vector<Span> followers;
+    std::vector<StreamThread> threads;
+};
+
+// Push-model search over a byte stream too large to hold, for patterns without
+// back-references. No byte is kept: while a match could still grow, the search for the
+// next one already runs from its end, and only one thread across all of them steps to
+// a state per byte, so live state is at most one thread per NFA state. The matches
+// found behind a pending one are held until it is final, which takes at most
+// lengths.max bytes; with an unbounded pattern, e.g. a(b*c)?, they are held until the
+// stream ends. Offsets are absolute from the first byte fed
+struct StreamMatcher {
+    const Nfa* nfa = nullptr;
+    size_t max_length = unbounded;
+    // Offset of the next byte to scan
+    size_t pos = 0;
+    std::list<StreamLevel> levels;
+    std::vector<StreamThread> next;
+    std::vector<StreamThread> stack;
+    // Per state, the last level step that reached it
+    std::vector<size_t> seen;
+    size_t generation = 0;
+    // Per state, one past the last position a thread stepped to it from
+    std::vector<size_t> claimed;
+};
+
+// False when the pattern has back-references or could not be compiled to an automaton
+bool open_stream(const CompiledPattern& pattern, StreamMatcher& stream);
+// Appends the leftmost-longest, non-overlapping matches that became final
+void feed_stream(StreamMatcher& stream, std::string_view chunk, std::vector<Span>& matches);
+void close_stream(StreamMatcher& stream, std::vector<Span>& matches);
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts outstanding tasks submitted against it, see wait()
+struct TaskGroup {
+    std::atomic<size_t> pending{0};
+};
+
+struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+};
+
+// Work-stealing pool: each worker pops its own queue LIFO and steals FIFO
+// from the others when it runs dry. Threads waiting on a group run queued
+// tasks meanwhile, so tasks may fork and wait on subtasks without deadlock
+struct ThreadPool {
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    void submit(TaskGroup& group, std::function<void()> task);
+    void wait(TaskGroup& group);
+    bool run_one();
+
+    size_t size() const;
+    size_t worker_index() const;
+
+private:
+    void worker_loop(size_t index);
+    bool pop_task(size_t index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> next_queue{0};
+    std::atomic<size_t> queued{0};
+    std::atomic<bool> stopping{false};
+    std::mutex idle_mutex;
+    std::condition_variable idle_cv;
+};
+
+// Worker count to use when none is requested
+size_t default_thread_count();
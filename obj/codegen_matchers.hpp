@@ -0,0 +1,305 @@
+// Generated by regex_codegen
+#pragma once
+
+#include <string_view>
+
+// Whole-input match of /abc/
+inline bool m0([[maybe_unused]] std::string_view input) {
+    if (input.size() != 3) return false;
+    [[maybe_unused]] auto p = reinterpret_cast<const unsigned char*>(input.data());
+    [[maybe_unused]] auto end = p + input.size();
+    if (end - p < 3 || p[0] != 'a' || p[1] != 'b' || p[2] != 'c') return false;
+    p += 3;
+    return p == end;
+}
+
+// Whole-input match of /(ab|c)*d/
+inline bool m1([[maybe_unused]] std::string_view input) {
+    if (input.size() < 1) return false;
+    [[maybe_unused]] auto p = reinterpret_cast<const unsigned char*>(input.data());
+    [[maybe_unused]] auto end = p + input.size();
+s0:
+    while (p != end) {
+        switch (*p++) {
+            case 'c': continue;
+            case 'a': goto s2;
+            case 'd': goto s3;
+            default: return false;
+        }
+    }
+    return false;
+s2:
+    if (end - p < 1 || p[0] != 'b') return false;
+    p += 1;
+    goto s0;
+s3:
+    return p == end;
+}
+
+// Whole-input match of /[^b]{1,3}c?/
+inline bool m2([[maybe_unused]] std::string_view input) {
+    if (input.size() < 1) return false;
+    if (input.size() > 4) return false;
+    [[maybe_unused]] auto p = reinterpret_cast<const unsigned char*>(input.data());
+    [[maybe_unused]] auto end = p + input.size();
+    if (p == end) return false;
+    switch (*p++) {
+        case 'b': return false;
+        default: goto s1;
+    }
+s1:
+    if (p == end) return true;
+    switch (*p++) {
+        case 'b': return false;
+        default: goto s3;
+    }
+s3:
+    if (p == end) return true;
+    switch (*p++) {
+        case 'b': return false;
+        default: goto s4;
+    }
+s4:
+    if (p == end) return true;
+    switch (*p++) {
+        case 'c': goto s5;
+        default: return false;
+    }
+s5:
+    return p == end;
+}
+
+// Whole-input match of /(a|bc)+b*/
+inline bool m3([[maybe_unused]] std::string_view input) {
+    if (input.size() < 1) return false;
+    [[maybe_unused]] auto p = reinterpret_cast<const unsigned char*>(input.data());
+    [[maybe_unused]] auto end = p + input.size();
+    if (p == end) return false;
+    switch (*p++) {
+        case 'a': goto s2;
+        case 'b': goto s3;
+        default: return false;
+    }
+s2:
+    while (p != end) {
+        switch (*p++) {
+            case 'a': continue;
+            case 'b': goto s4;
+            default: return false;
+        }
+    }
+    return true;
+s4:
+    if (p == end) return true;
+    switch (*p++) {
+        case 'c': goto s2;
+        case 'b': goto s5;
+        default: return false;
+    }
+s5:
+    while (p != end) {
+        switch (*p++) {
+            case 'b': continue;
+            default: return false;
+        }
+    }
+    return true;
+s3:
+    if (end - p < 1 || p[0] != 'c') return false;
+    p += 1;
+    goto s2;
+}
+
+// Whole-input match of /a{2,}|[b-z]{,2}/
+inline bool m4([[maybe_unused]] std::string_view input) {
+    [[maybe_unused]] auto p = reinterpret_cast<const unsigned char*>(input.data());
+    [[maybe_unused]] auto end = p + input.size();
+    if (p == end) return true;
+    switch (*p++) {
+        case 'a': goto s2;
+        case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i':
+        case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p': case 'q':
+        case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x': case 'y':
+        case 'z':
+            goto s3;
+        default: return false;
+    }
+s2:
+    if (end - p < 1 || p[0] != 'a') return false;
+    p += 1;
+    while (p != end) {
+        switch (*p++) {
+            case 'a': continue;
+            default: return false;
+        }
+    }
+    return true;
+s3:
+    if (p == end) return true;
+    switch (*p++) {
+        case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i':
+        case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p': case 'q':
+        case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x': case 'y':
+        case 'z':
+            goto s5;
+        default: return false;
+    }
+s5:
+    return p == end;
+}
+
+// Whole-input match of /[a-z0-9._%+-]+@[a-z0-9.-]+\.[a-z]{2,6}/
+inline bool m5([[maybe_unused]] std::string_view input) {
+    if (input.size() < 6) return false;
+    [[maybe_unused]] auto p = reinterpret_cast<const unsigned char*>(input.data());
+    [[maybe_unused]] auto end = p + input.size();
+    if (p == end) return false;
+    switch (*p++) {
+        case '%': case '+': case '-': case '.': case '0': case '1': case '2': case '3':
+        case '4': case '5': case '6': case '7': case '8': case '9': case '_': case 'a':
+        case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i':
+        case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p': case 'q':
+        case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x': case 'y':
+        case 'z':
+            goto s2;
+        default: return false;
+    }
+s2:
+    while (p != end) {
+        switch (*p++) {
+            case '%': case '+': case '-': case '.': case '0': case '1': case '2': case '3':
+            case '4': case '5': case '6': case '7': case '8': case '9': case '_': case 'a':
+            case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i':
+            case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p': case 'q':
+            case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x': case 'y':
+            case 'z':
+                continue;
+            case '@': goto s3;
+            default: return false;
+        }
+    }
+    return false;
+s3:
+    if (p == end) return false;
+    switch (*p++) {
+        case '-': case '.': case '0': case '1': case '2': case '3': case '4': case '5':
+        case '6': case '7': case '8': case '9': case 'a': case 'b': case 'c': case 'd':
+        case 'e': case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l':
+        case 'm': case 'n': case 'o': case 'p': case 'q': case 'r': case 's': case 't':
+        case 'u': case 'v': case 'w': case 'x': case 'y': case 'z':
+            goto s4;
+        default: return false;
+    }
+s4:
+    while (p != end) {
+        switch (*p++) {
+            case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6':
+            case '7': case '8': case '9': case 'a': case 'b': case 'c': case 'd': case 'e':
+            case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': case 'm':
+            case 'n': case 'o': case 'p': case 'q': case 'r': case 's': case 't': case 'u':
+            case 'v': case 'w': case 'x': case 'y': case 'z':
+                continue;
+            case '.': goto s5;
+            default: return false;
+        }
+    }
+    return false;
+s5:
+    while (p != end) {
+        switch (*p++) {
+            case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6':
+            case '7': case '8': case '9':
+                goto s4;
+            case '.': continue;
+            case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h':
+            case 'i': case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p':
+            case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x':
+            case 'y': case 'z':
+                goto s6;
+            default: return false;
+        }
+    }
+    return false;
+s6:
+    if (p == end) return false;
+    switch (*p++) {
+        case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6':
+        case '7': case '8': case '9':
+            goto s4;
+        case '.': goto s5;
+        case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h':
+        case 'i': case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p':
+        case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x':
+        case 'y': case 'z':
+            goto s7;
+        default: return false;
+    }
+s7:
+    if (p == end) return true;
+    switch (*p++) {
+        case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6':
+        case '7': case '8': case '9':
+            goto s4;
+        case '.': goto s5;
+        case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h':
+        case 'i': case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p':
+        case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x':
+        case 'y': case 'z':
+            goto s8;
+        default: return false;
+    }
+s8:
+    if (p == end) return true;
+    switch (*p++) {
+        case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6':
+        case '7': case '8': case '9':
+            goto s4;
+        case '.': goto s5;
+        case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h':
+        case 'i': case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p':
+        case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x':
+        case 'y': case 'z':
+            goto s9;
+        default: return false;
+    }
+s9:
+    if (p == end) return true;
+    switch (*p++) {
+        case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6':
+        case '7': case '8': case '9':
+            goto s4;
+        case '.': goto s5;
+        case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h':
+        case 'i': case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p':
+        case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x':
+        case 'y': case 'z':
+            goto s10;
+        default: return false;
+    }
+s10:
+    if (p == end) return true;
+    switch (*p++) {
+        case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6':
+        case '7': case '8': case '9':
+            goto s4;
+        case '.': goto s5;
+        case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h':
+        case 'i': case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p':
+        case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x':
+        case 'y': case 'z':
+            goto s11;
+        default: return false;
+    }
+s11:
+    if (p == end) return true;
+    switch (*p++) {
+        case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6':
+        case '7': case '8': case '9': case 'a': case 'b': case 'c': case 'd': case 'e':
+        case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': case 'm':
+        case 'n': case 'o': case 'p': case 'q': case 'r': case 's': case 't': case 'u':
+        case 'v': case 'w': case 'x': case 'y': case 'z':
+            goto s4;
+        case '.': goto s5;
+        default: return false;
+    }
+}
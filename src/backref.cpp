@@ -0,0 +1,296 @@
+#include "backref.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <list>
+#include <map>
+#include <utility>
+
+// Open, start and end per slot, one record per thread that recorded a span; threads
+// share the record they forked with. Records no thread holds are dropped after every
+// position, so the pool stays as large as the live threads
+struct SpanPool {
+    size_t width = 0;
+    std::vector<size_t> records;
+    std::vector<size_t> kept;
+    std::vector<uint32_t> moved;
+
+    size_t* get(uint32_t id) {
+        return records.data() + id * width;
+    }
+
+    uint32_t add() {
+        if (width == 0) return 0;
+        records.resize(records.size() + width, unbounded);
+        return static_cast<uint32_t>(records.size() / width - 1);
+    }
+
+    // A record of the thread's own, for it to write into
+    uint32_t copy(uint32_t id) {
+        uint32_t to = add();
+        std::copy_n(get(id), width, get(to));
+        return to;
+    }
+
+    bool equal(uint32_t a, uint32_t b) {
+        return std::equal(get(a), get(a) + width, get(b));
+    }
+};
+
+struct RefThread {
+    uint32_t state = no_node;
+    uint32_t spans = 0;
+    size_t start = 0;
+};
+
+// Span records already run at the current position, per state; cleared through touched.
+// Without REF states a thread's future does not depend on its spans, so the first
+// thread at a state stands for every later one
+struct SeenThreads {
+    bool by_spans = false;
+    std::vector<std::vector<uint32_t>> spans;
+    std::vector<uint32_t> touched;
+
+    bool insert(const RefThread& t, SpanPool& pool) {
+        auto& bucket = spans[t.state];
+        if (bucket.empty()) touched.push_back(t.state);
+        if (!by_spans && !bucket.empty()) return false;
+        for (auto id : bucket) {
+            if (pool.equal(id, t.spans)) return false;
+        }
+        bucket.push_back(t.spans);
+        return true;
+    }
+
+    void clear() {
+        for (auto state : touched) spans[state].clear();
+        touched.clear();
+    }
+};
+
+// One leftmost-longest search, seeding a thread per position from from until it finds a
+// match. next and later hold the threads for the next position and, when a REF moved
+// them further, for the position they resume at. followers are the final matches of the
+// searches that started after this one's match and have ended
+struct SearchLevel {
+    size_t from = 0;
+    bool found = false;
+    NfaMatch match;
+    std::vector<NfaMatch> followers;
+    std::vector<RefThread> current;
+    std::vector<RefThread> next;
+    std::map<size_t, std::vector<RefThread>> later;
+
+    bool idle() const {
+        return current.empty() && later.empty();
+    }
+};
+
+void take_match(SpanPool& pool, const RefThread& t, size_t end, NfaMatch& match) {
+    size_t slots = pool.width / 3;
+    const size_t* spans = pool.get(t.spans);
+    match.start = t.start;
+    match.end = end;
+    match.starts.resize(slots);
+    match.ends.resize(slots);
+    for (size_t slot = 0; slot < slots; slot++) {
+        match.starts[slot] = spans[3 * slot + 1];
+        match.ends[slot] = spans[3 * slot + 2];
+    }
+}
+
+// Next position a match can begin at, skipping bytes no first CLASS accepts
+size_t next_start(const Nfa& nfa, std::string_view input, size_t pos) {
+    if (nfa.starts_anywhere) return pos;
+    while (pos < input.size() && !nfa.first[static_cast<unsigned char>(input[pos])]) pos++;
+    return pos;
+}
+
+void compact_spans(SpanPool& pool, std::list<SearchLevel>& levels) {
+    if (pool.width == 0) return;
+    pool.moved.assign(pool.records.size() / pool.width, no_node);
+    pool.kept.clear();
+    auto keep = [&](RefThread& t) {
+        auto& to = pool.moved[t.spans];
+        if (to == no_node) {
+            to = static_cast<uint32_t>(pool.kept.size() / pool.width);
+            pool.kept.insert(pool.kept.end(), pool.get(t.spans), pool.get(t.spans) + pool.width);
+        }
+        t.spans = to;
+    };
+    for (auto& level : levels) {
+        for (auto& t : level.current) keep(t);
+        for (auto& [at, parked] : level.later) {
+            for (auto& t : parked) keep(t);
+        }
+    }
+    std::swap(pool.records, pool.kept);
+}
+
+// Runs one level's threads at pos. True when its match changed
+bool step_level(const Nfa& nfa, std::string_view input, size_t pos, size_t max_length, SearchLevel& level, SpanPool& pool, SeenThreads& seen, SeenThreads& claimed, std::vector<RefThread>& stack) {
+    size_t N = input.size();
+    bool changed = false;
+    auto parked = level.later.find(pos);
+    if (parked != level.later.end()) {
+        level.current.insert(level.current.end(), parked->second.begin(), parked->second.end());
+        level.later.erase(parked);
+    }
+    // Earliest start first, so a merged thread keeps the leftmost one
+    std::stable_sort(level.current.begin(), level.current.end(), [](const RefThread& a, const RefThread& b) {
+        return a.start < b.start;
+    });
+    seen.clear();
+    stack.assign(level.current.rbegin(), level.current.rend());
+    level.current.clear();
+    auto resume = [&](RefThread t, size_t at) {
+        if (at == pos) {
+            stack.push_back(t);
+        } else if (at == pos + 1) {
+            if (claimed.insert(t, pool)) level.next.push_back(t);
+        } else {
+            level.later[at].push_back(t);
+        }
+    };
+    while (!stack.empty()) {
+        auto t = stack.back();
+        stack.pop_back();
+        if (t.state == no_node || (level.found && t.start > level.match.start)) continue;
+        if (pos - t.start > max_length || !seen.insert(t, pool)) continue;
+        const auto& st = nfa.states[t.state];
+        switch (st.op) {
+            case NfaOp::CLASS:
+                if (pos == N || !nfa.classes[st.cls][static_cast<unsigned char>(input[pos])]) break;
+                t.state = st.out;
+                resume(t, pos + 1);
+                break;
+            case NfaOp::SPLIT:
+                stack.push_back({st.out1, t.spans, t.start});
+                t.state = st.out;
+                stack.push_back(t);
+                break;
+            case NfaOp::EPSILON: case NfaOp::RESET: case NfaOp::COUNT: case NfaOp::REPEAT:
+                t.state = st.out;
+                stack.push_back(t);
+                break;
+            case NfaOp::OPEN:
+                t.spans = pool.copy(t.spans);
+                pool.get(t.spans)[3 * st.cls] = pos;
+                t.state = st.out;
+                stack.push_back(t);
+                break;
+            case NfaOp::CLOSE: {
+                // A stale open position would only keep otherwise equal threads apart
+                t.spans = pool.copy(t.spans);
+                size_t* spans = pool.get(t.spans);
+                spans[3 * st.cls + 1] = std::exchange(spans[3 * st.cls], unbounded);
+                spans[3 * st.cls + 2] = pos;
+                t.state = st.out;
+                stack.push_back(t);
+                break;
+            }
+            case NfaOp::REF: {
+                const size_t* spans = pool.get(t.spans);
+                size_t start = spans[3 * st.cls + 1];
+                if (start == unbounded) break;
+                size_t size = spans[3 * st.cls + 2] - start;
+                if (size > N - pos || std::memcmp(input.data() + pos, input.data() + start, size) != 0) break;
+                t.state = st.out;
+                resume(t, pos + size);
+                break;
+            }
+            case NfaOp::MATCH: {
+                auto& match = level.match;
+                if (!level.found || t.start < match.start || (t.start == match.start && pos > match.end)) {
+                    take_match(pool, t, pos, match);
+                    level.found = true;
+                    changed = true;
+                }
+                break;
+            }
+        }
+    }
+    return changed;
+}
+
+size_t find_matches(const Nfa& nfa, std::string_view input, size_t from, bool anchored, bool all, size_t max_length, std::vector<NfaMatch>& matches) {
+    size_t N = input.size();
+    size_t before = matches.size();
+    SpanPool pool{3 * nfa.slot_node.size(), {}, {}, {}};
+    bool by_spans = std::any_of(nfa.states.begin(), nfa.states.end(), [](const NfaState& st) { return st.op == NfaOp::REF; });
+    SeenThreads seen{by_spans, std::vector<std::vector<uint32_t>>(nfa.states.size()), {}};
+    SeenThreads claimed = seen;
+    std::vector<RefThread> stack;
+    // The pending match first; each later level searches from where the one before it
+    // would end, so no byte is scanned twice. A thread stepping to a state an earlier level
+    // already stepped to is dropped: it could only match where that level's match grows,
+    // which drops this level too
+    std::list<SearchLevel> levels(1);
+    levels.front().from = from;
+    for (size_t pos = from; pos <= N; pos++) {
+        auto& first = levels.front();
+        if (levels.size() == 1 && first.idle() && !first.found) {
+            if (anchored && pos > from) break;
+            if (!anchored) {
+                pos = next_start(nfa, input, std::max(pos, first.from));
+                if (pos == N && !nfa.starts_anywhere) break;
+            }
+        }
+        claimed.clear();
+        for (auto it = levels.begin(); it != levels.end(); ++it) {
+            auto& level = *it;
+            if (!level.found && pos >= level.from && (!anchored || pos == from)) {
+                level.current.push_back({nfa.start, pool.add(), pos});
+            }
+            if (!step_level(nfa, input, pos, max_length, level, pool, seen, claimed, stack) || !all) continue;
+            // An empty match is stepped over, so the next one starts strictly later
+            levels.erase(std::next(it), levels.end());
+            level.followers.clear();
+            levels.emplace_back().from = (level.match.end > level.match.start) ? level.match.end : level.match.end + 1;
+        }
+        for (auto& level : levels) {
+            std::swap(level.current, level.next);
+            level.next.clear();
+        }
+        compact_spans(pool, levels);
+        // A level with nothing left to run is final once the ones before it are
+        for (auto it = std::next(levels.begin()); it != levels.end();) {
+            if (!it->found || !it->idle()) {
+                ++it;
+                continue;
+            }
+            auto& followers = std::prev(it)->followers;
+            followers.push_back(std::move(it->match));
+            followers.insert(followers.end(), std::make_move_iterator(it->followers.begin()), std::make_move_iterator(it->followers.end()));
+            it = levels.erase(it);
+        }
+        while (!levels.empty() && levels.front().found && levels.front().idle()) {
+            auto& done = levels.front();
+            matches.push_back(std::move(done.match));
+            if (!all) return 1;
+            matches.insert(matches.end(), std::make_move_iterator(done.followers.begin()), std::make_move_iterator(done.followers.end()));
+            levels.pop_front();
+        }
+        if (levels.empty()) break;
+    }
+    return matches.size() - before;
+}
+
+bool longest_match(const Nfa& nfa, std::string_view input, size_t from, bool anchored, size_t max_length, NfaMatch& match) {
+    std::vector<NfaMatch> matches;
+    if (find_matches(nfa, input, from, anchored, false, max_length, matches) == 0) return false;
+    match = std::move(matches.front());
+    return true;
+}
+
+bool ref_match(const Nfa& nfa, std::string_view input, MatchScratch& scratch) {
+    // Anchored at 0, the longest match is the whole input whenever one is
+    NfaMatch match;
+    if (!longest_match(nfa, input, 0, true, unbounded, match) || match.end != input.size()) return false;
+    for (size_t slot = 0, imax = nfa.slot_node.size(); slot < imax; slot++) {
+        size_t start = match.starts[slot];
+        scratch.start[nfa.slot_node[slot]] = start;
+        scratch.size[nfa.slot_node[slot]] = (start == unbounded) ? unbounded : match.ends[slot] - start;
+    }
+    return true;
+}
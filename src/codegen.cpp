@@ -0,0 +1,239 @@
+#include "codegen.hpp"
+#include "dfa.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <map>
+#include <string>
+#include <vector>
+
+// Where a byte leads from a state: a state id, or no_node for a dead end
+struct CodeState {
+    bool accept = false;
+    std::array<uint32_t, 256> target{};
+};
+
+// Bytes matched one after the other from a state with a single way forward
+struct CodeRun {
+    std::string bytes;
+    uint32_t target = no_node;
+};
+
+std::string byte_literal(unsigned char c) {
+    if (c == '\'' || c == '\\') return std::string("'\\") + static_cast<char>(c) + "'";
+    if (std::isprint(c)) return std::string("'") + static_cast<char>(c) + "'";
+    return std::to_string(c);
+}
+
+// Pattern text for a comment, without line breaks or a trailing line splice
+std::string comment_text(std::string_view text) {
+    static const char digits[] = "0123456789abcdef";
+    std::string result;
+    for (unsigned char c : text) {
+        if (std::isprint(c)) {
+            result += static_cast<char>(c);
+        } else {
+            result += "\\x";
+            result += digits[c >> 4];
+            result += digits[c & 15];
+        }
+    }
+    return result;
+}
+
+bool is_identifier(std::string_view name) {
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) return false;
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    });
+}
+
+// States that can still reach an accepting one keep their ids; the others become no_node
+std::vector<CodeState> live_states(const Nfa& nfa, const DfaCache& dfa) {
+    size_t count = dfa.sets.size();
+    size_t classes = nfa.rep.size();
+    std::vector<uint8_t> live(dfa.accept.begin(), dfa.accept.end());
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t s = 0; s < count; s++) {
+            if (live[s]) continue;
+            for (size_t c = 0; c < classes && !live[s]; c++) live[s] = live[dfa.next[s * classes + c]];
+            changed |= live[s];
+        }
+    }
+    std::vector<CodeState> states(count);
+    for (size_t s = 0; s < count; s++) {
+        states[s].accept = dfa.accept[s];
+        for (size_t b = 0; b < 256; b++) {
+            uint32_t next = dfa.next[s * classes + nfa.byte_class[b]];
+            states[s].target[b] = live[next] ? next : no_node;
+        }
+    }
+    if (!live[dfa.start]) states[dfa.start].target.fill(no_node);
+    return states;
+}
+
+// A non-accepting state left by exactly one byte
+bool single_byte(const CodeState& state, unsigned char& byte, uint32_t& target) {
+    if (state.accept) return false;
+    size_t ways = 0;
+    for (size_t b = 0; b < 256; b++) {
+        if (state.target[b] == no_node) continue;
+        byte = static_cast<unsigned char>(b);
+        target = state.target[b];
+        ways++;
+    }
+    return ways == 1;
+}
+
+// Runs cannot cycle: a loop of single-byte, non-accepting states never reaches an
+// accepting one, so live_states has cut it
+CodeRun find_run(const std::vector<CodeState>& states, uint32_t from) {
+    CodeRun run;
+    run.target = from;
+    unsigned char byte;
+    uint32_t target;
+    while (single_byte(states[run.target], byte, target)) {
+        run.bytes += static_cast<char>(byte);
+        run.target = target;
+    }
+    return run;
+}
+
+std::string jump(uint32_t target, uint32_t self) {
+    if (target == no_node) return "return false;";
+    if (target == self) return "continue;";
+    return "goto s" + std::to_string(target) + ";";
+}
+
+// Cases grouped per target, the largest group left to default
+void write_switch(const CodeState& state, uint32_t self, std::string_view indent, std::ostream& out) {
+    std::map<uint32_t, std::vector<unsigned char>> groups;
+    for (size_t b = 0; b < 256; b++) groups[state.target[b]].push_back(static_cast<unsigned char>(b));
+    auto largest = std::max_element(groups.begin(), groups.end(), [](const auto& a, const auto& b) {
+        return a.second.size() < b.second.size();
+    });
+    out << indent << "switch (*p++) {\n";
+    for (const auto& [target, bytes] : groups) {
+        if (target == largest->first) continue;
+        std::string line;
+        for (size_t i = 0; i < bytes.size(); i++) {
+            if (i % 8 == 0) line += std::string(indent) + "    ";
+            line += "case " + byte_literal(bytes[i]) + ":";
+            line += (i % 8 == 7 || i + 1 == bytes.size()) ? "\n" : " ";
+        }
+        if (bytes.size() == 1) {
+            line.back() = ' ';
+            out << line << jump(target, self) << "\n";
+        } else {
+            out << line << indent << "        " << jump(target, self) << "\n";
+        }
+    }
+    out << indent << "    default: " << jump(largest->first, self) << "\n";
+    out << indent << "}\n";
+}
+
+void write_guard(const LengthSet& lengths, std::ostream& out) {
+    if (lengths.period == 0) {
+        out << "    if (input.size() != " << lengths.min << ") return false;\n";
+        return;
+    }
+    if (lengths.min > 0) out << "    if (input.size() < " << lengths.min << ") return false;\n";
+    if (lengths.max != unbounded) out << "    if (input.size() > " << lengths.max << ") return false;\n";
+    if (lengths.period > 1) {
+        out << "    if ((input.size() - " << lengths.min << ") % " << lengths.period << " != 0) return false;\n";
+    }
+}
+
+// A run falls through when its target is the next block written
+void write_state(const std::vector<CodeState>& states, uint32_t s, uint32_t next, std::ostream& out) {
+    const auto& state = states[s];
+    auto run = find_run(states, s);
+    if (!run.bytes.empty()) {
+        out << "    if (end - p < " << run.bytes.size();
+        for (size_t i = 0; i < run.bytes.size(); i++) {
+            out << " || p[" << i << "] != " << byte_literal(static_cast<unsigned char>(run.bytes[i]));
+        }
+        out << ") return false;\n";
+        out << "    p += " << run.bytes.size() << ";\n";
+        if (run.target != next) out << "    " << jump(run.target, no_node) << "\n";
+        return;
+    }
+    std::string at_end = state.accept ? "true" : "false";
+    bool dead = std::all_of(state.target.begin(), state.target.end(), [](uint32_t t) { return t == no_node; });
+    if (dead) {
+        out << "    return " << (state.accept ? "p == end" : "false") << ";\n";
+        return;
+    }
+    bool loops = std::find(state.target.begin(), state.target.end(), s) != state.target.end();
+    if (loops) {
+        out << "    while (p != end) {\n";
+        write_switch(state, s, "        ", out);
+        out << "    }\n";
+        out << "    return " << at_end << ";\n";
+        return;
+    }
+    out << "    if (p == end) return " << at_end << ";\n";
+    write_switch(state, no_node, "    ", out);
+}
+
+// States a block jumps to
+void gather_targets(const std::vector<CodeState>& states, uint32_t s, uint32_t next, std::vector<uint32_t>& targets) {
+    auto run = find_run(states, s);
+    if (!run.bytes.empty()) {
+        if (run.target != next) targets.push_back(run.target);
+        return;
+    }
+    for (auto t : states[s].target) {
+        if (t != no_node && t != s) targets.push_back(t);
+    }
+}
+
+bool generate_matcher(const CompiledPattern& pattern, std::string_view name, std::ostream& out) {
+    if (!pattern.regular) return false;
+    DfaCache dfa;
+    if (!build_dfa(pattern.nfa, dfa)) return false;
+    auto states = live_states(pattern.nfa, dfa);
+
+    // Blocks depth first, each run directly followed by its target
+    std::vector<uint32_t> order;
+    std::vector<uint8_t> placed(states.size(), false);
+    std::vector<uint32_t> pending{dfa.start};
+    std::vector<uint32_t> targets;
+    while (!pending.empty()) {
+        uint32_t s = pending.back();
+        pending.pop_back();
+        while (s != no_node && !placed[s]) {
+            placed[s] = true;
+            order.push_back(s);
+            auto run = find_run(states, s);
+            if (!run.bytes.empty()) {
+                s = run.target;
+                continue;
+            }
+            targets.clear();
+            gather_targets(states, s, no_node, targets);
+            pending.insert(pending.end(), targets.rbegin(), targets.rend());
+            s = no_node;
+        }
+    }
+    // Labeled only where jumped to
+    std::vector<uint8_t> labeled(states.size(), false);
+    for (size_t i = 0; i < order.size(); i++) {
+        targets.clear();
+        gather_targets(states, order[i], (i + 1 < order.size()) ? order[i + 1] : no_node, targets);
+        for (auto t : targets) labeled[t] = true;
+    }
+
+    out << "// Whole-input match of /" << comment_text(pattern.text) << "/\n";
+    out << "inline bool " << name << "([[maybe_unused]] std::string_view input) {\n";
+    write_guard(cold(pattern.tree, root(pattern.tree)).lengths, out);
+    out << "    [[maybe_unused]] auto p = reinterpret_cast<const unsigned char*>(input.data());\n";
+    out << "    [[maybe_unused]] auto end = p + input.size();\n";
+    for (size_t i = 0; i < order.size(); i++) {
+        if (labeled[order[i]]) out << "s" << order[i] << ":\n";
+        write_state(states, order[i], (i + 1 < order.size()) ? order[i + 1] : no_node, out);
+    }
+    out << "}\n";
+    return true;
+}
@@ -1,4 +1,7 @@
 #include "core.hpp"
+#include <type_traits>
+
+static_assert(std::is_trivially_destructible_v<Expr>, "node array must be freeable in one deallocation");
 
 Expr::Expr(GroupType group_type,
            OpType op_type,
@@ -6,21 +9,16 @@ Expr::Expr(GroupType group_type,
            std::string_view group,
            std::string_view op,
            std::string_view link,
-           size_t ref_id,
-           size_t idx,
-           size_t depth,
-           Expr* parent,
-           std::vector<std::unique_ptr<Expr>> children,
-           std::vector<Equation> eqs,
-           std::string x_frag,
-           std::vector<std::string> b_eqs,
-           std::string xvar,
-           std::string bvar,
+           uint32_t ref_id,
+           uint32_t idx,
+           uint32_t depth,
+           uint32_t self,
+           uint32_t parent,
+           uint32_t first_child,
+           uint32_t child_count,
            size_t n,
            size_t m,
-           size_t start,
-           size_t size,
-           bool active)
+           CharClass cls)
     : group_type(group_type),
       op_type(op_type),
       link_type(link_type),
@@ -30,16 +28,68 @@ Expr::Expr(GroupType group_type,
       ref_id(ref_id),
       idx(idx),
       depth(depth),
-      parent(std::move(parent)),
-      children(std::move(children)),
-      eqs(std::move(eqs)),
-      x_frag(std::move(x_frag)),
-      b_eqs(std::move(b_eqs)),
-      xvar(std::move(xvar)),
-      bvar(std::move(bvar)),
+      self(self),
+      parent(parent),
+      first_child(first_child),
+      child_count(child_count),
       n(n),
       m(m),
-      start(start),
-      size(size),
-      active(active) {}
+      cls(cls) {}
+
+std::span<Expr> children(Expr& expr) {
+    if (expr.child_count == 0) return {};
+    return {&expr - expr.self + expr.first_child, expr.child_count};
+}
+
+std::span<const Expr> children(const Expr& expr) {
+    if (expr.child_count == 0) return {};
+    return {&expr - expr.self + expr.first_child, expr.child_count};
+}
+
+Expr* parent_of(Expr& expr) {
+    return (expr.parent == no_node) ? nullptr : &expr - expr.self + expr.parent;
+}
+
+const Expr* parent_of(const Expr& expr) {
+    return (expr.parent == no_node) ? nullptr : &expr - expr.self + expr.parent;
+}
+
+bool is_leaf(const Expr& expr) {
+    return expr.child_count == 0;
+}
+
+uint32_t add_nodes(ExprTree& tree, size_t count) {
+    uint32_t first = static_cast<uint32_t>(tree.nodes.size());
+    for (size_t i = 0; i < count; i++) {
+        Expr node;
+        node.self = first + static_cast<uint32_t>(i);
+        tree.nodes.push_back(node);
+    }
+    tree.cold.resize(tree.nodes.size());
+    return first;
+}
+
+Expr& root(ExprTree& tree) {
+    return tree.nodes[0];
+}
+
+const Expr& root(const ExprTree& tree) {
+    return tree.nodes[0];
+}
+
+ExprCold& cold(ExprTree& tree, const Expr& expr) {
+    return tree.cold[expr.self];
+}
+
+const ExprCold& cold(const ExprTree& tree, const Expr& expr) {
+    return tree.cold[expr.self];
+}
+
+size_t sat_mul(size_t a, size_t b) {
+    if (a == 0 || b == 0) return 0;
+    return (a > unbounded / b) ? unbounded : a * b;
+}
 
+size_t sat_add(size_t a, size_t b) {
+    return (a > unbounded - b) ? unbounded : a + b;
+}
@@ -0,0 +1,174 @@
+#include "derive.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+// values holds open, start and end per span slot, then a count and a flag per count
+// slot, the flag set while a REPEAT pass of that slot began at the current position.
+// offset is how many bytes of its span the REF at state has matched
+struct CountThread {
+    uint32_t state = no_node;
+    size_t offset = 0;
+    std::vector<size_t> values;
+};
+
+// Keys of the threads already run at the current position: fixed-width records laid end
+// to end in keys, found through an open-addressing table of record ids
+struct SeenKeys {
+    size_t width = 0;
+    std::vector<size_t> keys;
+    // Record id + 1, 0 for an empty slot
+    std::vector<uint32_t> table;
+
+    size_t hash(const size_t* key) const {
+        uint64_t h = 0;
+        for (size_t i = 0; i < width; i++) h = (h ^ key[i]) * 0x9e3779b97f4a7c15;
+        return h ^ (h >> 29);
+    }
+
+    void place(uint32_t id) {
+        size_t mask = table.size() - 1;
+        size_t i = hash(keys.data() + id * width) & mask;
+        while (table[i] != 0) i = (i + 1) & mask;
+        table[i] = id + 1;
+    }
+
+    bool insert(const std::vector<size_t>& key) {
+        size_t count = keys.size() / width;
+        if (2 * (count + 1) > table.size()) {
+            table.assign(std::max<size_t>(16, 2 * table.size()), 0);
+            for (uint32_t id = 0; id < count; id++) place(id);
+        }
+        size_t mask = table.size() - 1;
+        for (size_t i = hash(key.data()) & mask; table[i] != 0; i = (i + 1) & mask) {
+            if (std::equal(key.begin(), key.end(), keys.begin() + (table[i] - 1) * width)) return false;
+        }
+        keys.insert(keys.end(), key.begin(), key.end());
+        place(static_cast<uint32_t>(count));
+        return true;
+    }
+
+    void clear() {
+        keys.clear();
+        std::fill(table.begin(), table.end(), 0);
+    }
+};
+
+// Threads with equal keys run alike from here on; without counts, only their counts differ
+void thread_key(const CountThread& t, size_t counts, size_t slots, bool with_counts, std::vector<size_t>& key) {
+    key.clear();
+    key.push_back(t.state);
+    key.push_back(t.offset);
+    for (size_t i = 0, imax = t.values.size(); i < imax; i++) {
+        if (with_counts || i < counts || i >= counts + slots) key.push_back(t.values[i]);
+    }
+}
+
+size_t derive_counts(const Nfa& nfa, std::string_view input, MatchMode mode, std::vector<std::vector<size_t>>& matches) {
+    size_t N = input.size();
+    size_t counts = 3 * nfa.slot_node.size();
+    size_t slots = nfa.count_node.size();
+    size_t began = counts + slots;
+    bool first_only = (mode == MatchMode::EXISTS || mode == MatchMode::FIRST);
+    std::vector<size_t> values(began + slots, 0);
+    std::fill(values.begin(), values.begin() + counts, unbounded);
+    std::vector<CountThread> current{{nfa.start, 0, std::move(values)}};
+    std::vector<CountThread> next;
+    std::vector<CountThread> stack;
+    // Matches are keyed by their counts alone, under a state no thread has, so threads
+    // differing only in spans or pass flags report one vector
+    uint32_t match_key = static_cast<uint32_t>(nfa.states.size());
+    std::vector<size_t> key;
+    SeenKeys seen;
+    seen.width = 2 + (first_only ? began : began + slots);
+    size_t total = 0;
+    for (size_t pos = 0; pos <= N && !current.empty(); pos++) {
+        seen.clear();
+        stack.assign(current.rbegin(), current.rend());
+        current.clear();
+        auto step = [&](CountThread t) {
+            std::fill(t.values.begin() + began, t.values.end(), 0);
+            next.push_back(std::move(t));
+        };
+        while (!stack.empty()) {
+            auto t = std::move(stack.back());
+            stack.pop_back();
+            if (t.state == no_node) continue;
+            thread_key(t, counts, slots, !first_only, key);
+            if (!seen.insert(key)) continue;
+            const auto& st = nfa.states[t.state];
+            switch (st.op) {
+                case NfaOp::CLASS:
+                    if (pos == N || !nfa.classes[st.cls][static_cast<unsigned char>(input[pos])]) break;
+                    t.state = st.out;
+                    step(std::move(t));
+                    break;
+                case NfaOp::SPLIT:
+                    stack.push_back({st.out1, t.offset, t.values});
+                    t.state = st.out;
+                    stack.push_back(std::move(t));
+                    break;
+                case NfaOp::EPSILON:
+                    t.state = st.out;
+                    stack.push_back(std::move(t));
+                    break;
+                case NfaOp::OPEN:
+                    t.values[3 * st.cls] = pos;
+                    t.state = st.out;
+                    stack.push_back(std::move(t));
+                    break;
+                case NfaOp::CLOSE:
+                    t.values[3 * st.cls + 1] = std::exchange(t.values[3 * st.cls], unbounded);
+                    t.values[3 * st.cls + 2] = pos;
+                    t.state = st.out;
+                    stack.push_back(std::move(t));
+                    break;
+                case NfaOp::REF: {
+                    size_t start = t.values[3 * st.cls + 1];
+                    if (start == unbounded) break;
+                    if (t.offset == t.values[3 * st.cls + 2] - start) {
+                        t.offset = 0;
+                        t.state = st.out;
+                        stack.push_back(std::move(t));
+                    } else if (pos < N && input[pos] == input[start + t.offset]) {
+                        t.offset++;
+                        step(std::move(t));
+                    }
+                    break;
+                }
+                case NfaOp::RESET:
+                    t.values[counts + st.cls] = 0;
+                    t.values[began + st.cls] = 0;
+                    t.state = st.out;
+                    stack.push_back(std::move(t));
+                    break;
+                case NfaOp::COUNT:
+                    t.values[counts + st.cls]++;
+                    t.state = st.out;
+                    stack.push_back(std::move(t));
+                    break;
+                case NfaOp::REPEAT:
+                    // A pass beginning where the last one did would have read nothing
+                    if (t.values[began + st.cls]) break;
+                    t.values[counts + st.cls]++;
+                    t.values[began + st.cls] = 1;
+                    t.state = st.out;
+                    stack.push_back(std::move(t));
+                    break;
+                case NfaOp::MATCH: {
+                    if (pos != N) break;
+                    key.assign(seen.width, 0);
+                    key[0] = match_key;
+                    std::copy(t.values.begin() + counts, t.values.begin() + began, key.begin() + 2);
+                    if (!seen.insert(key)) break;
+                    total++;
+                    if (mode != MatchMode::COUNT) matches.emplace_back(t.values.begin() + counts, t.values.begin() + began);
+                    if (first_only) return total;
+                    break;
+                }
+            }
+        }
+        std::swap(current, next);
+    }
+    return total;
+}
@@ -0,0 +1,114 @@
+#include "dfa.hpp"
+#include <algorithm>
+
+void reset_dfa(const Nfa& nfa, DfaCache& cache) {
+    cache.nfa_id = nfa.id;
+    cache.sets.clear();
+    cache.accept.clear();
+    cache.next.clear();
+    cache.ids.clear();
+    cache.start = no_node;
+    cache.marks.assign(nfa.states.size(), 0);
+    cache.generation = 0;
+}
+
+// Adds the epsilon closure of state to set, keeping only CLASS and MATCH states
+void add_closure(const Nfa& nfa, DfaCache& cache, uint32_t state, std::vector<uint32_t>& set, std::vector<uint32_t>& stack) {
+    stack.push_back(state);
+    while (!stack.empty()) {
+        uint32_t s = stack.back();
+        stack.pop_back();
+        if (s == no_node || cache.marks[s] == cache.generation) continue;
+        cache.marks[s] = cache.generation;
+        const auto& st = nfa.states[s];
+        if (st.op == NfaOp::SPLIT) {
+            stack.push_back(st.out1);
+            stack.push_back(st.out);
+        } else if (st.op == NfaOp::EPSILON) {
+            stack.push_back(st.out);
+        } else {
+            set.push_back(s);
+        }
+    }
+}
+
+void next_generation(DfaCache& cache) {
+    if (++cache.generation == 0) {
+        std::fill(cache.marks.begin(), cache.marks.end(), 0);
+        cache.generation = 1;
+    }
+}
+
+uint32_t intern_state(const Nfa& nfa, DfaCache& cache, std::vector<uint32_t> set) {
+    std::sort(set.begin(), set.end());
+    std::string key(reinterpret_cast<const char*>(set.data()), set.size() * sizeof(uint32_t));
+    auto found = cache.ids.find(key);
+    if (found != cache.ids.end()) return found->second;
+    uint32_t id = static_cast<uint32_t>(cache.sets.size());
+    bool accept = std::any_of(set.begin(), set.end(), [&](uint32_t s) {
+        return nfa.states[s].op == NfaOp::MATCH;
+    });
+    cache.sets.push_back(std::move(set));
+    cache.accept.push_back(accept);
+    cache.next.resize(cache.next.size() + nfa.rep.size(), no_node);
+    cache.ids.emplace(std::move(key), id);
+    return id;
+}
+
+uint32_t step(const Nfa& nfa, DfaCache& cache, uint32_t from, uint8_t byte_class) {
+    uint8_t byte = nfa.rep[byte_class];
+    std::vector<uint32_t> set;
+    std::vector<uint32_t> stack;
+    next_generation(cache);
+    for (uint32_t s : cache.sets[from]) {
+        const auto& st = nfa.states[s];
+        if (st.op == NfaOp::CLASS && nfa.classes[st.cls][byte]) add_closure(nfa, cache, st.out, set, stack);
+    }
+    return intern_state(nfa, cache, std::move(set));
+}
+
+uint32_t start_state(const Nfa& nfa, DfaCache& cache) {
+    std::vector<uint32_t> set;
+    std::vector<uint32_t> stack;
+    next_generation(cache);
+    add_closure(nfa, cache, nfa.start, set, stack);
+    return intern_state(nfa, cache, std::move(set));
+}
+
+bool dfa_match(const Nfa& nfa, DfaCache& cache, std::string_view input) {
+    if (cache.nfa_id != nfa.id) reset_dfa(nfa, cache);
+    if (cache.start == no_node) cache.start = start_state(nfa, cache);
+    size_t classes = nfa.rep.size();
+    uint32_t state = cache.start;
+    for (unsigned char c : input) {
+        if (cache.sets[state].empty()) return false;
+        uint8_t byte_class = nfa.byte_class[c];
+        uint32_t next = cache.next[state * classes + byte_class];
+        if (next == no_node) {
+            if (cache.sets.size() >= max_dfa_states) {
+                // Keep only the state being left, then carry on building
+                auto current = cache.sets[state];
+                reset_dfa(nfa, cache);
+                state = intern_state(nfa, cache, std::move(current));
+            }
+            next = step(nfa, cache, state, byte_class);
+            cache.next[state * classes + byte_class] = next;
+        }
+        state = next;
+    }
+    return cache.accept[state];
+}
+
+bool build_dfa(const Nfa& nfa, DfaCache& cache) {
+    reset_dfa(nfa, cache);
+    cache.start = start_state(nfa, cache);
+    size_t classes = nfa.rep.size();
+    for (uint32_t state = 0; state < cache.sets.size(); state++) {
+        for (size_t byte_class = 0; byte_class < classes; byte_class++) {
+            if (cache.sets.size() > max_dfa_states) return false;
+            uint32_t next = step(nfa, cache, state, static_cast<uint8_t>(byte_class));
+            cache.next[state * classes + byte_class] = next;
+        }
+    }
+    return true;
+}
@@ -3,112 +3,199 @@
 #include <charconv>
 #include <limits>
 #include <algorithm>
+#include <numeric>
 #include <sstream>
 #include <iostream>
 
-// Check if token is a bvar, e.g. "{b0}"
-bool is_bvar(const std::string& s) {
-    return s.find("{b") != std::string::npos;
+bool is_bvar(const Var& var) {
+    return var.type == VarType::B;
 }
 
-// Check if token is a numeric constant like "1", "42"
-bool is_constant(const std::string& s) {
-    return !s.empty() && std::all_of(s.begin(), s.end(), ::isdigit);
+bool is_constant(const Term& term) {
+    return term.vars.empty();
 }
 
-std::string to_beq(std::string_view x_frag) {
-    std::string result;
-    size_t term_start = 0;
-    while (term_start < x_frag.size()) {
-        size_t term_end = x_frag.find('+', term_start);
-        if (term_end == std::string_view::npos) {
-            term_end = x_frag.size();
-        }
-        std::string_view term = x_frag.substr(term_start, term_end - term_start);
-        size_t bvar_start = term.find("{b", 0);
-        while (bvar_start != std::string_view::npos) {
-            size_t bvar_end = term.find("}", bvar_start + 2);
-            std::string_view bvar = term.substr(bvar_start, bvar_end - bvar_start + 1);
-            result += bvar;
-            result += "*";
-            bvar_start = term.find("{b", bvar_end + 1);
+Frag to_beq(const Frag& x_frag) {
+    Frag result;
+    for (const auto& term : x_frag) {
+        Term bterm{1, {}};
+        for (const auto& var : term.vars) {
+            if (is_bvar(var)) bterm.vars.push_back(var);
         }
-        if (!result.empty()) {
-            result[result.size() - 1] = '+';
-        }
-        term_start = term_end + 1;
+        if (!bterm.vars.empty()) result.push_back(std::move(bterm));
     }
-    if (!result.empty()) {
-        result.erase(result.size() - 1, 1);
-    }
-
     return result;
 }
 
 // Post-order collection of bvar constraints
-void collect_b_eqs(const Expr& expr, std::vector<std::string>& b_eqs, bool is_root = false) {
-    for (const auto& ch : expr.children) {
-        collect_b_eqs(*ch, b_eqs, false);
+void collect_b_eqs(const ExprTree& tree, const Expr& expr, std::vector<Constraint>& b_eqs, bool is_root) {
+    for (const auto& ch : children(expr)) {
+        collect_b_eqs(tree, ch, b_eqs, false);
     }
-    std::string beq = to_beq(expr.x_frag);
-    if (!beq.empty() && std::count(beq.begin(), beq.end(), 'b') > 1) {
-        beq += is_root ? "==1" : "<=1";
-        b_eqs.push_back(beq);
+    Frag beq = to_beq(x_frag(tree, expr));
+    size_t bcount = 0;
+    for (const auto& term : beq) bcount += term.vars.size();
+    if (bcount > 1) {
+        b_eqs.push_back({std::move(beq), is_root ? RelType::EQ : RelType::LE, 1});
     }
 }
 
-// Returns the single semicolon-separated equation string
-std::string gen_eqs(const Expr& expr, size_t input_size) {
-    std::stringstream ss;
+std::vector<Constraint> gen_system(const ExprTree& tree, size_t input_size) {
+    std::vector<Constraint> system;
 
     // First constraint: x_frag = input length
-    ss << expr.x_frag << "=" << input_size;
+    system.push_back({x_frag(tree, root(tree)), RelType::EQ, input_size});
 
     // Then collect bvar constraints
-    std::vector<std::string> b_eqs;
-    collect_b_eqs(expr, b_eqs, true);
+    collect_b_eqs(tree, root(tree), system, true);
+    return system;
+}
 
-    for (const auto& beq : b_eqs) {
-        ss << ";" << beq;
+// Returns the single semicolon-separated equation string
+std::string gen_eqs(const ExprTree& tree, size_t input_size) {
+    std::stringstream ss;
+    auto system = gen_system(tree, input_size);
+    for (size_t i = 0, imax = system.size(); i < imax; i++) {
+        if (i > 0) ss << ";";
+        ss << to_string(system[i]);
     }
-
     return ss.str();
 }
 
-std::string_view scan_const(std::string_view input) {
-    auto maybe_const = scan_number(input);
-    auto rest = input.substr(maybe_const.size());
-    return (rest.empty() || rest[0] == '+') ?
-               (maybe_const) :
-               ("");
+void scalar_mult_frag(Frag& frag, const Var& c) {
+    for (auto& term : frag) {
+        term.vars.push_back(c);
+    }
 }
 
-void scalar_mult_frag(std::string& frag, std::string& c) {
-    size_t last_pos = 0;
-    size_t pos = 0;
-    std::string_view term;
-    while ((pos = frag.find('+', pos)) != std::string::npos) {
-        term = frag.substr(last_pos, pos);
-        frag.insert(pos, "*" + c);
-        pos += c.length() + 2;
-        last_pos = pos;
-    }
-    frag += "*" + c;
+Var n_m_to_xvar(size_t n, size_t m, size_t xvar_count) {
+    return {VarType::X, xvar_count, n, m};
 }
 
-std::string n_m_to_xvar(size_t n, size_t m, size_t xvar_count) {
+std::string var_name(const Var& var) {
+    return (is_bvar(var) ? "b" : "x") + std::to_string(var.id);
+}
+
+std::string to_string(const Var& var) {
+    if (var.type == VarType::NONE) return "";
+    if (is_bvar(var)) return "{" + var_name(var) + "}";
     size_t min = 0;
-    size_t max = std::numeric_limits<decltype(m)>::max();
-    std::string nt = (n > min) ? (std::to_string(n)) : ("");
-    std::string mt = (m < max) ? (std::to_string(m)) : ("");
-    auto count = std::to_string(xvar_count);
-    if (n == min && m == max) {
-        return "{x" + count + "}";
+    size_t max = std::numeric_limits<decltype(var.m)>::max();
+    std::string nt = (var.n > min) ? (std::to_string(var.n)) : ("");
+    std::string mt = (var.m < max) ? (std::to_string(var.m)) : ("");
+    if (var.n == min && var.m == max) {
+        return "{" + var_name(var) + "}";
     }
     if (nt == mt) {
-        return "{x" + count + ":" + nt + "}";
+        return "{" + var_name(var) + ":" + nt + "}";
     }
-    return "{x" + count + ":" + nt + "," + mt + "}";
+    return "{" + var_name(var) + ":" + nt + "," + mt + "}";
+}
+
+std::string to_string(const Term& term) {
+    std::string result = std::to_string(term.coeff);
+    for (const auto& var : term.vars) {
+        result += "*" + to_string(var);
+    }
+    return result;
+}
+
+std::string to_string(const Frag& frag) {
+    std::string result;
+    for (const auto& term : frag) {
+        if (!result.empty()) result += "+";
+        result += to_string(term);
+    }
+    return result;
+}
+
+std::string to_string(const Constraint& con) {
+    std::string result;
+    bool bvars_only = std::all_of(con.lhs.begin(), con.lhs.end(), [](const Term& term) {
+        return term.coeff == 1 && !term.vars.empty() && std::all_of(term.vars.begin(), term.vars.end(), is_bvar);
+    });
+    if (!bvars_only) {
+        result = to_string(con.lhs);
+    } else {
+        for (const auto& term : con.lhs) {
+            if (!result.empty()) result += "+";
+            for (size_t i = 0, imax = term.vars.size(); i < imax; i++) {
+                if (i > 0) result += "*";
+                result += to_string(term.vars[i]);
+            }
+        }
+    }
+    result += (con.rel == RelType::LE) ? "<=" : "=";
+    if (bvars_only && con.rel == RelType::EQ) result += "=";
+    return result + std::to_string(con.rhs);
+}
+
+// Token forms: "{x0}", "{x0:2}", "{x0:2,5}", "{x0:,5}", "{x0:1,}", "{b3}"
+Var parse_var(std::string_view token) {
+    auto inner = token.substr(1, token.size() - 2);
+    size_t colon = inner.find(':');
+    auto id = inner.substr(1, colon - 1);
+    Var var{(inner[0] == 'b') ? VarType::B : VarType::X, 0, 0, std::numeric_limits<size_t>::max()};
+    std::from_chars(id.data(), id.data() + id.size(), var.id);
+    if (is_bvar(var)) {
+        var.m = 1;
+        return var;
+    }
+    if (colon != std::string_view::npos) {
+        auto range = inner.substr(colon + 1);
+        size_t comma = range.find(',');
+        auto n = range.substr(0, comma);
+        std::from_chars(n.data(), n.data() + n.size(), var.n);
+        if (comma == std::string_view::npos) {
+            var.m = var.n;
+        } else {
+            auto m = range.substr(comma + 1);
+            if (!m.empty()) std::from_chars(m.data(), m.data() + m.size(), var.m);
+        }
+    }
+    return var;
+}
+
+Term parse_term(std::string_view text) {
+    Term term{1, {}};
+    size_t factor_start = 0;
+    while (factor_start < text.size()) {
+        size_t factor_end = text.find('*', factor_start);
+        if (factor_end == std::string_view::npos) factor_end = text.size();
+        auto factor = text.substr(factor_start, factor_end - factor_start);
+        if (!factor.empty() && factor[0] == '{') {
+            term.vars.push_back(parse_var(factor));
+        } else {
+            size_t c = 0;
+            std::from_chars(factor.data(), factor.data() + factor.size(), c);
+            term.coeff *= c;
+        }
+        factor_start = factor_end + 1;
+    }
+    return term;
+}
+
+Frag parse_frag(std::string_view text) {
+    Frag frag;
+    size_t term_start = 0;
+    while (term_start < text.size()) {
+        size_t term_end = text.find('+', term_start);
+        if (term_end == std::string_view::npos) term_end = text.size();
+        frag.push_back(parse_term(text.substr(term_start, term_end - term_start)));
+        term_start = term_end + 1;
+    }
+    return frag;
+}
+
+Constraint parse_constraint(std::string_view text) {
+    Constraint con;
+    size_t rel_pos = text.find_first_of("<=");
+    con.lhs = parse_frag(text.substr(0, rel_pos));
+    auto rhs = text.substr(rel_pos);
+    con.rel = rhs.starts_with("<=") ? RelType::LE : RelType::EQ;
+    rhs.remove_prefix(rhs.find_first_not_of("<="));
+    std::from_chars(rhs.data(), rhs.data() + rhs.size(), con.rhs);
+    return con;
 }
 
 /*
@@ -140,36 +227,146 @@ void match(Expr& expr) {
 }
 */
 
-void gen_frags(Expr& expr, size_t& xvar_count, size_t& bvar_count) {
-    if (expr.children.empty()) {
-        auto number = std::to_string(expr.group.size());
-        expr.x_frag = number;
+Frag x_frag(const ExprTree& tree, const Expr& expr) {
+    const auto& expr_cold = cold(tree, expr);
+    Frag frag;
+    frag.reserve(expr_cold.term_count);
+    for (uint32_t k = expr_cold.first_term, kmax = k + expr_cold.term_count; k < kmax; k++) {
+        const auto& term = tree.terms[k];
+        auto vars = tree.term_vars.begin() + term.first_var;
+        frag.push_back({term.coeff, {vars, vars + term.var_count}});
+    }
+    return frag;
+}
+
+void store_frag(ExprTree& tree, const Expr& expr, const Frag& frag) {
+    auto& expr_cold = cold(tree, expr);
+    expr_cold.first_term = static_cast<uint32_t>(tree.terms.size());
+    expr_cold.term_count = static_cast<uint32_t>(frag.size());
+    for (const auto& term : frag) {
+        tree.terms.push_back({term.coeff, static_cast<uint32_t>(tree.term_vars.size()), static_cast<uint32_t>(term.vars.size())});
+        tree.term_vars.insert(tree.term_vars.end(), term.vars.begin(), term.vars.end());
+    }
+}
+
+// Builds expr's x_frag. A child's is stored once the alternation it sits in has
+// multiplied in its bvar, as that is the form its parent sums
+Frag build_frag(ExprTree& tree, Expr& expr, size_t& xvar_count, size_t& bvar_count) {
+    Frag frag;
+    if (is_leaf(expr)) {
+        frag = {Term{expr.atom_count, {}}};
     }
     LinkType last_link = LinkType::NONE;
     size_t cat_from = 0;
-    // size_t b_eq_from = bvar_count;
-    size_t max = expr.children.size();
+    auto chs = children(expr);
+    size_t max = chs.size();
+    std::vector<Frag> ch_frags(max);
     for (size_t i = 0; i < max; i++) {
-        auto* ch = expr.children[i].get();
-        gen_frags(*ch, xvar_count, bvar_count);
+        auto& ch = chs[i];
+        ch_frags[i] = build_frag(tree, ch, xvar_count, bvar_count);
         bool last_alt = (last_link == LinkType::ALTERNATION);
-        bool alt = (ch->link_type == LinkType::ALTERNATION);
+        bool alt = (ch.link_type == LinkType::ALTERNATION);
         if (last_alt || alt) {
-            ch->bvar = "{b" + std::to_string(bvar_count++) + "}";
+            auto& ch_cold = cold(tree, ch);
+            ch_cold.bvar = {VarType::B, bvar_count++, 0, 1};
             for (size_t j = cat_from; j <= i; j++) {
-                scalar_mult_frag(expr.children[j]->x_frag, ch->bvar);
+                scalar_mult_frag(ch_frags[j], ch_cold.bvar);
             }
             cat_from = i + 1;
         }
-        last_link = ch->link_type;
+        last_link = ch.link_type;
     }
     for (size_t i = 0; i < max; i++) {
-        auto* ch = expr.children[i].get();
-        if (!expr.x_frag.empty()) expr.x_frag += "+";
-        expr.x_frag += ch->x_frag;
+        store_frag(tree, chs[i], ch_frags[i]);
+        frag.insert(frag.end(), ch_frags[i].begin(), ch_frags[i].end());
     }
     if (expr.op_type != OpType::NONE && expr.op_type != OpType::ONE) {
-        expr.xvar = n_m_to_xvar(expr.n, expr.m, xvar_count++);
-        scalar_mult_frag(expr.x_frag, expr.xvar);
+        auto& expr_cold = cold(tree, expr);
+        expr_cold.xvar = n_m_to_xvar(expr.n, expr.m, xvar_count++);
+        scalar_mult_frag(frag, expr_cold.xvar);
+    }
+    return frag;
+}
+
+void gen_frags(ExprTree& tree, Expr& expr, size_t& xvar_count, size_t& bvar_count) {
+    store_frag(tree, expr, build_frag(tree, expr, xvar_count, bvar_count));
+}
+
+void gen_frags(ExprTree& tree) {
+    size_t xvar_count = 0;
+    size_t bvar_count = 0;
+    tree.terms.clear();
+    tree.term_vars.clear();
+    gen_frags(tree, root(tree), xvar_count, bvar_count);
+}
+
+size_t abs_diff(size_t a, size_t b) {
+    return (a > b) ? a - b : b - a;
+}
+
+LengthSet concat_lengths(const LengthSet& a, const LengthSet& b) {
+    return {sat_add(a.min, b.min), sat_add(a.max, b.max), std::gcd(a.period, b.period)};
+}
+
+LengthSet alternate_lengths(const LengthSet& a, const LengthSet& b) {
+    size_t period = std::gcd(std::gcd(a.period, b.period), abs_diff(a.min, b.min));
+    return {std::min(a.min, b.min), std::max(a.max, b.max), period};
+}
+
+// n..m copies of content. Each copy may pick its own length, so a fixed count only
+// shifts the residue; a range of counts also steps by content.min
+LengthSet repeat_lengths(const LengthSet& content, size_t n, size_t m) {
+    if (m == 0 || content.max == 0) return {0, 0, 0};
+    size_t period = (m > n) ? std::gcd(content.min, content.period) : content.period;
+    return {sat_mul(n, content.min), sat_mul(m, content.max), period};
+}
+
+LengthSet leaf_lengths(const Expr& expr) {
+    if (is_ref(expr)) return {};
+    return {expr.atom_count, expr.atom_count, 0};
+}
+
+// Bottom-up over the same structure as gen_frags: children concatenate, runs joined by
+// alternation links pick one member, and the op repeats the result x_frag-style
+const LengthSet& gen_lengths(ExprTree& tree, const Expr& expr) {
+    auto& lengths = cold(tree, expr).lengths;
+    if (is_leaf(expr)) {
+        lengths = leaf_lengths(expr);
+    } else {
+        lengths = {0, 0, 0};
+        LengthSet alt_run;
+        bool prev_alt = false;
+        bool alt = false;
+        auto chs = children(expr);
+        for (size_t i = 0, imax = chs.size(); i < imax; i++) {
+            const auto& ch_lengths = gen_lengths(tree, chs[i]);
+            prev_alt = alt;
+            alt = (chs[i].link_type == LinkType::ALTERNATION);
+            alt_run = prev_alt ? alternate_lengths(alt_run, ch_lengths) : ch_lengths;
+            if (!alt) lengths = concat_lengths(lengths, alt_run);
+        }
+        if (alt) lengths = concat_lengths(lengths, alt_run);
+    }
+    // A root op is also carried by the root's only child, and match_up never applies it
+    bool is_root = (expr.parent == no_node);
+    if (!is_root && expr.op_type != OpType::NONE && expr.op_type != OpType::ONE) {
+        lengths = repeat_lengths(lengths, expr.n, expr.m);
     }
+    return lengths;
+}
+
+void gen_lengths(ExprTree& tree) {
+    gen_lengths(tree, root(tree));
+    // The matcher splices a back-reference's group into another subtree, so no static
+    // bound holds for the whole pattern once one appears
+    bool has_ref = std::any_of(tree.nodes.begin(), tree.nodes.end(), [](const Expr& e) {
+        return is_ref(e);
+    });
+    if (has_ref) cold(tree, root(tree)).lengths = {};
+}
+
+bool admits_length(const LengthSet& lengths, size_t length) {
+    if (length < lengths.min || length > lengths.max) return false;
+    if (lengths.period == 0) return length == lengths.min;
+    return (length - lengths.min) % lengths.period == 0;
 }
@@ -0,0 +1,168 @@
+#include "frontend.hpp"
+#include "frags.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+void print_expr(const ExprTree& tree, const Expr& expr, const MatchScratch& scratch, std::ostream& out, int indent) {
+    std::string pad(indent * 2, ' ');
+    out << pad << "Expr: group=\"" << expr.group << "\", op=\"" << expr.op
+        << "\", link=\"" << expr.link << "\", active=" << int(scratch.active[expr.self]) << "\n";
+    out << pad << "  x_frag: " << to_string(x_frag(tree, expr)) << "\n";
+    for (const auto& ch : children(expr)) {
+        print_expr(tree, ch, scratch, out, indent + 1);
+    }
+}
+
+void print_batch_result(size_t line_no, const MatchResult& result, MatchMode mode, std::ostream& out) {
+    out << line_no << "\t";
+    if (!result.found) {
+        out << "no match\n";
+        return;
+    }
+    out << "match";
+    if (mode == MatchMode::COUNT) out << "\t" << result.count;
+    const auto& matches = result.matches;
+    for (size_t i = 0, imax = matches.size(); i < imax; i++) {
+        out << (i == 0 ? "\t" : "; ");
+        for (size_t j = 0, jmax = matches[i].size(); j < jmax; j++) {
+            if (j > 0) out << ",";
+            out << matches[i][j];
+        }
+    }
+    out << "\n";
+}
+
+bool parse_match_mode(std::string_view name, MatchMode& mode) {
+    if (name == "exists") mode = MatchMode::EXISTS;
+    else if (name == "first") mode = MatchMode::FIRST;
+    else if (name == "count") mode = MatchMode::COUNT;
+    else if (name == "all") mode = MatchMode::ALL;
+    else return false;
+    return true;
+}
+
+bool read_line(LineReader& reader, std::string& storage, std::string_view& line) {
+    if (!reader.in) return next_line(reader.mapped, reader.pos, line);
+    if (!std::getline(*reader.in, storage)) return false;
+    line = storage;
+    return true;
+}
+
+int run_batch(const std::string& regex, LineReader& reader, std::ostream& out, MatchMode mode) {
+    auto pattern = compile_pattern(regex);
+    if (!pattern) {
+        std::cerr << "Parse failed.\n";
+        return 1;
+    }
+
+    std::string storage;
+    std::string_view input;
+    MatchScratch scratch;
+    size_t line_no = 0;
+    while (read_line(reader, storage, input)) {
+        line_no++;
+        print_batch_result(line_no, query_pattern(*pattern, input, scratch, mode), mode, out);
+    }
+    return 0;
+}
+
+struct BatchChunk {
+    size_t first_line = 0;
+    // Lines read from a stream; a deque so the views into them stay put
+    std::deque<std::string> owned;
+    std::vector<std::string_view> lines;
+    std::ostringstream out;
+    std::atomic<bool> done{false};
+};
+
+int run_batch_parallel(const std::string& regex, LineReader& reader, std::ostream& out, size_t threads, MatchMode mode) {
+    auto pattern = compile_pattern(regex);
+    if (!pattern) {
+        std::cerr << "Parse failed.\n";
+        return 1;
+    }
+
+    constexpr size_t chunk_lines = 1024;
+    ThreadPool pool(threads);
+    std::vector<MatchScratch> scratches(pool.size() + 1);
+    std::deque<std::unique_ptr<BatchChunk>> in_flight;
+    size_t max_in_flight = 4 * pool.size();
+
+    auto flush_front = [&] {
+        auto& chunk = *in_flight.front();
+        while (!chunk.done) {
+            if (!pool.run_one()) std::this_thread::yield();
+        }
+        out << chunk.out.str();
+        in_flight.pop_front();
+    };
+
+    size_t line_no = 0;
+    bool eof = false;
+    while (!eof) {
+        auto chunk = std::make_unique<BatchChunk>();
+        chunk->first_line = line_no + 1;
+        std::string storage;
+        std::string_view input;
+        while (chunk->lines.size() < chunk_lines && read_line(reader, storage, input)) {
+            if (reader.in) input = chunk->owned.emplace_back(std::move(storage));
+            chunk->lines.push_back(input);
+        }
+        eof = chunk->lines.size() < chunk_lines;
+        line_no += chunk->lines.size();
+        if (chunk->lines.empty()) break;
+
+        auto* job = chunk.get();
+        pool.submit([&, job] {
+            auto& scratch = scratches[pool.worker_index()];
+            for (size_t i = 0, imax = job->lines.size(); i < imax; i++) {
+                print_batch_result(job->first_line + i, query_pattern(*pattern, job->lines[i], scratch, mode), mode, job->out);
+            }
+            job->done = true;
+        });
+        in_flight.push_back(std::move(chunk));
+        if (in_flight.size() >= max_in_flight) flush_front();
+    }
+    while (!in_flight.empty()) flush_front();
+    return 0;
+}
+
+int run_interactive(std::istream& in, std::ostream& out) {
+    std::string regex, input;
+    out << "Enter a regex: ";
+    std::getline(in, regex);
+    out << "Enter input string: ";
+    std::getline(in, input);
+
+    auto pattern = compile_pattern(regex);
+    if (!pattern) {
+        std::cerr << "Parse failed.\n";
+        return 1;
+    }
+    const auto& expr = root(pattern->tree);
+
+    MatchScratch scratch;
+    if (!prepare_scratch(*pattern, input, scratch)) optimize_parse_tree(expr, input, scratch);
+    out << "\nExpression Tree:\n";
+    print_expr(pattern->tree, expr, scratch, out);
+
+    auto result = query_pattern(*pattern, input, scratch, MatchMode::ALL);
+    if (!result.found) {
+        out << "no match\n";
+        return 0;
+    }
+    // A pattern without repetitions matches with an empty count vector
+    if (result.matches.empty()) result.matches.emplace_back();
+    for (const auto& match : result.matches) {
+        out << "match: ";
+        for (size_t count : match) out << count << ", ";
+        out << "\n";
+    }
+    return 0;
+}
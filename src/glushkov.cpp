@@ -0,0 +1,79 @@
+#include "glushkov.hpp"
+#include <vector>
+
+// Position bits of the CLASS states reachable from state without consuming input;
+// match is set when MATCH is reachable too
+uint64_t closure_bits(const Nfa& nfa, const std::vector<uint32_t>& position, uint32_t state, bool& match) {
+    uint64_t bits = 0;
+    std::vector<uint8_t> seen(nfa.states.size(), false);
+    std::vector<uint32_t> stack{state};
+    while (!stack.empty()) {
+        uint32_t s = stack.back();
+        stack.pop_back();
+        if (s == no_node || seen[s]) continue;
+        seen[s] = true;
+        const auto& st = nfa.states[s];
+        switch (st.op) {
+            case NfaOp::CLASS: bits |= uint64_t{1} << position[s]; break;
+            case NfaOp::SPLIT: stack.push_back(st.out1); stack.push_back(st.out); break;
+            case NfaOp::EPSILON: case NfaOp::OPEN: case NfaOp::CLOSE: case NfaOp::RESET: case NfaOp::COUNT: case NfaOp::REPEAT:
+                stack.push_back(st.out);
+                break;
+            case NfaOp::REF: break;
+            case NfaOp::MATCH: match = true; break;
+        }
+    }
+    return bits;
+}
+
+bool compile_glushkov(const Nfa& nfa, Glushkov& glushkov) {
+    glushkov = {};
+    if (!nfa.slot_node.empty()) return false;
+    std::vector<uint32_t> position(nfa.states.size(), 0);
+    for (size_t s = 0; s < nfa.states.size(); s++) {
+        if (nfa.states[s].op != NfaOp::CLASS) continue;
+        if (glushkov.positions == max_glushkov_positions) return false;
+        position[s] = static_cast<uint32_t>(++glushkov.positions);
+    }
+
+    std::array<uint64_t, 64> follow{};
+    bool match = false;
+    follow[0] = closure_bits(nfa, position, nfa.start, match);
+    if (match) glushkov.accept |= 1;
+    for (size_t s = 0; s < nfa.states.size(); s++) {
+        const auto& st = nfa.states[s];
+        if (st.op != NfaOp::CLASS) continue;
+        uint64_t bit = uint64_t{1} << position[s];
+        match = false;
+        follow[position[s]] = closure_bits(nfa, position, st.out, match);
+        if (match) glushkov.accept |= bit;
+        for (size_t b = 0; b < 256; b++) {
+            if (nfa.classes[st.cls][b]) glushkov.byte_mask[b] |= bit;
+        }
+    }
+
+    for (size_t k = 0; k * 8 <= glushkov.positions; k++) {
+        auto& table = glushkov.follow[k];
+        for (size_t b = 1; b < 256; b++) {
+            // Each entry extends the one without its lowest bit
+            size_t low = b & -b;
+            size_t i = k * 8 + __builtin_ctzll(low);
+            table[b] = table[b ^ low] | follow[i];
+        }
+    }
+    return true;
+}
+
+bool glushkov_match(const Glushkov& glushkov, std::string_view input) {
+    size_t chunks = glushkov.positions / 8 + 1;
+    uint64_t active = 1;
+    for (unsigned char c : input) {
+        uint64_t next = 0;
+        for (size_t k = 0; k < chunks; k++) {
+            next |= glushkov.follow[k][(active >> (8 * k)) & 0xff];
+        }
+        active = next & glushkov.byte_mask[c];
+        if (!active) return false;
+    }
+    return (active & glushkov.accept) != 0;
+}
@@ -0,0 +1,130 @@
+#include "literals.hpp"
+#include <algorithm>
+
+bool is_plain_text(std::string_view text) {
+    return !text.empty() && text.find_first_of("\\[]().*+?{}|^$") == std::string_view::npos;
+}
+
+bool at_least_once(const Expr& expr) {
+    return expr.op_type == OpType::NONE || expr.op_type == OpType::ONE || expr.n > 0;
+}
+
+void flush_literal(RequiredLiteral& run, std::vector<RequiredLiteral>& literals) {
+    if (!run.text.empty()) literals.push_back(std::move(run));
+    run = {};
+}
+
+// expr is known to be required; walks its children the way plan_down groups them
+void extract_literals(const Expr& expr, std::vector<RequiredLiteral>& literals) {
+    RequiredLiteral run;
+    bool prev_alt = false;
+    bool alt = false;
+    for (const auto& ch : children(expr)) {
+        prev_alt = alt;
+        alt = (ch.link_type == LinkType::ALTERNATION);
+        if (alt || prev_alt || !at_least_once(ch)) {
+            flush_literal(run, literals);
+            continue;
+        }
+        bool literal = is_leaf(ch) && ch.group_type == GroupType::IMPLICIT && is_plain_text(ch.group);
+        if (!literal) {
+            flush_literal(run, literals);
+            if (!is_leaf(ch)) extract_literals(ch, literals);
+            continue;
+        }
+        run.text += ch.group;
+        run.leaves.push_back(ch.self);
+        // A repeated leaf still occurs at least once, but nothing can be chained after it
+        if (ch.op_type != OpType::NONE && ch.op_type != OpType::ONE) flush_literal(run, literals);
+    }
+    flush_literal(run, literals);
+}
+
+void extract_literals(const ExprTree& tree, std::vector<RequiredLiteral>& literals) {
+    const auto& expr = root(tree);
+    if (is_leaf(expr)) {
+        if (expr.group_type == GroupType::IMPLICIT && is_plain_text(expr.group)) literals.push_back({std::string{expr.group}, {expr.self}});
+    } else {
+        extract_literals(expr, literals);
+    }
+    std::stable_sort(literals.begin(), literals.end(), [](const RequiredLiteral& a, const RequiredLiteral& b) {
+        return a.text.size() > b.text.size();
+    });
+}
+
+void build_literal_automaton(const std::vector<std::string>& literals, LiteralAutomaton& automaton) {
+    automaton = {};
+    CharClass used;
+    for (const auto& text : literals) {
+        for (unsigned char c : text) used[c] = true;
+    }
+    uint16_t classes = 0;
+    for (size_t b = 0; b < 256; b++) {
+        if (used[b]) automaton.byte_class[b] = classes++;
+    }
+    if (classes < 256) {
+        for (size_t b = 0; b < 256; b++) {
+            if (!used[b]) automaton.byte_class[b] = classes;
+        }
+        classes++;
+    }
+    automaton.classes = classes;
+    auto& next = automaton.next;
+    auto add_state = [&] {
+        next.resize(next.size() + classes, no_node);
+        automaton.literal.push_back(no_node);
+        automaton.output.push_back(no_node);
+        return static_cast<uint32_t>(automaton.literal.size() - 1);
+    };
+    add_state();
+    // Trie first, no_node marking missing edges
+    for (uint32_t id = 0; id < literals.size(); id++) {
+        uint32_t state = 0;
+        for (unsigned char c : literals[id]) {
+            size_t edge = state * classes + automaton.byte_class[c];
+            if (next[edge] == no_node) {
+                uint32_t child = add_state();
+                next[edge] = child;
+            }
+            state = next[edge];
+        }
+        automaton.literal[state] = id;
+        automaton.ends.push_back(state);
+    }
+    // Breadth first, a state's failure target is complete before it is; missing edges
+    // take the failure target's
+    std::vector<uint32_t> fail(automaton.literal.size(), 0);
+    std::vector<uint32_t> queue{0};
+    for (size_t i = 0; i < queue.size(); i++) {
+        uint32_t state = queue[i];
+        for (size_t c = 0; c < classes; c++) {
+            uint32_t& edge = next[state * classes + c];
+            uint32_t fallback = (state == 0) ? 0 : next[fail[state] * classes + c];
+            if (edge == no_node) {
+                edge = fallback;
+                continue;
+            }
+            fail[edge] = fallback;
+            automaton.output[edge] = (automaton.literal[fallback] != no_node) ? fallback : automaton.output[fallback];
+            queue.push_back(edge);
+        }
+    }
+}
+
+void find_literals(const LiteralAutomaton& automaton, std::string_view input, std::vector<uint8_t>& reported, std::vector<uint32_t>& found) {
+    size_t before = found.size();
+    size_t total = automaton.ends.size();
+    uint32_t state = 0;
+    for (unsigned char c : input) {
+        state = automaton.next[state * automaton.classes + automaton.byte_class[c]];
+        uint32_t hit = (automaton.literal[state] != no_node) ? state : automaton.output[state];
+        // A reported state's suffixes were reported with it
+        while (hit != no_node && !reported[hit]) {
+            reported[hit] = true;
+            found.push_back(automaton.literal[hit]);
+            hit = automaton.output[hit];
+        }
+        if (found.size() - before == total) break;
+    }
+    for (size_t i = before; i < found.size(); i++) reported[automaton.ends[found[i]]] = false;
+}
@@ -0,0 +1,50 @@
+#include "mapped_file.hpp"
+#include "simd.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+void MappedFile::release() {
+    if (data) munmap(data, size);
+    data = nullptr;
+    size = 0;
+}
+
+bool MappedFile::open(const std::string& path) {
+    release();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    if (ok && st.st_size > 0) {
+        void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ok = false;
+        } else {
+            data = mapped;
+            size = st.st_size;
+            madvise(data, size, MADV_SEQUENTIAL);
+        }
+    }
+    // The mapping holds its own reference to the file
+    close(fd);
+    return ok;
+}
+
+std::string_view MappedFile::view() const {
+    return {static_cast<const char*>(data), size};
+}
+
+bool next_line(std::string_view text, size_t& pos, std::string_view& line) {
+    if (pos >= text.size()) return false;
+    size_t end = find_byte(text, '\n', pos);
+    if (end == std::string_view::npos) end = text.size();
+    line = text.substr(pos, end - pos);
+    pos = (end < text.size()) ? end + 1 : end;
+    return true;
+}
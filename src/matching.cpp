@@ -1,10 +1,10 @@
 #include "matching.hpp"
 #include "parse.hpp"
+#include "frags.hpp"
 #include <algorithm>
 #include <utility>
 #include <numeric>
 #include <string_view>
-#include <charconv>
 
 template <typename T>
 std::vector<T> vec_cat(const std::vector<T>& v1, const std::vector<T>& v2) {
@@ -13,7 +13,79 @@ std::vector<T> vec_cat(const std::vector<T>& v1, const std::vector<T>& v2) {
     return combined;
 }
 
-void match_up(std::vector<std::tuple<Expr*, size_t, std::string>> exprs, std::vector<Expr*>& groups, const size_t N, const std::string_view input, std::vector<size_t> match, std::vector<std::vector<size_t>>& matches) {
+bool stopped(const MatchScratch& scratch) {
+    return scratch.stop && scratch.stop->load(std::memory_order_relaxed);
+}
+
+bool halts_on_match(const MatchScratch& scratch) {
+    return scratch.stop && (scratch.mode == MatchMode::EXISTS || scratch.mode == MatchMode::FIRST);
+}
+
+void append_atoms(std::string& key, const AtomString& atoms) {
+    key.append(reinterpret_cast<const char*>(atoms.data()), atoms.size() * sizeof(uint32_t));
+}
+
+// Canonical sub-problem keys: the node set plus, going up, each partial width and atom string
+std::string up_key(const std::vector<UpExpr>& exprs) {
+    std::string key;
+    for (const auto& [e, div, leaf] : exprs) {
+        key += std::to_string(e ? e->self : no_node) + ":" + std::to_string(div) + ":" + std::to_string(leaf.size()) + ":";
+        append_atoms(key, leaf);
+    }
+    return key;
+}
+
+std::string down_key(const std::vector<const Expr*>& exprs) {
+    std::string key;
+    for (auto* e : exprs) {
+        key += std::to_string(e->self) + ",";
+    }
+    return key;
+}
+
+bool match_atoms(const AtomString& leaf, std::string_view input, size_t pos, const MatchScratch& scratch) {
+    if (input.size() - std::min(pos, input.size()) < leaf.size()) return false;
+    for (size_t i = 0, imax = leaf.size(); i < imax; i++) {
+        if (!match_leaf((*scratch.atoms)[leaf[i]], input, pos + i)) return false;
+    }
+    return true;
+}
+
+// run[pos] is the number of back-to-back matches of the atom string starting at pos.
+// max_chain replays the greedy scan match_up used to do: start at 0, consume a whole chain,
+// resume one past its end
+const RunTable& leaf_runs(const AtomString& leaf, const size_t N, const std::string_view input, MatchScratch& scratch) {
+    auto& memo = scratch.memo;
+    std::string key;
+    append_atoms(key, leaf);
+    auto found = memo.runs.find(key);
+    if (found != memo.runs.end()) return found->second;
+    auto& table = memo.runs[key];
+
+    size_t width = leaf.size();
+    table.run.assign(N + 1, 0);
+    // An empty string repeats without consuming anything
+    if (width == 0) {
+        table.max_chain = unbounded;
+        return table;
+    }
+    // Nothing matches before the first occurrence of any byte of the first atom
+    size_t first = std::min(first_match((*scratch.atoms)[leaf[0]], scratch), N);
+    for (size_t pos = N; pos-- > first;) {
+        if (!match_atoms(leaf, input, pos, scratch)) continue;
+        size_t next = pos + width;
+        table.run[pos] = 1 + ((next < N) ? table.run[next] : 0);
+    }
+    table.max_chain = 0;
+    for (size_t pos = first; pos < N;) {
+        size_t chain = table.run[pos];
+        table.max_chain = std::max(table.max_chain, chain);
+        pos += chain * width + 1;
+    }
+    return table;
+}
+
+bool plan_up(const std::vector<UpExpr>& exprs, const size_t N, const std::string_view input, MatchScratch& scratch, UpPlan& plan) {
     size_t g = 0;
     size_t s = 0;
     for (size_t i = 0, max = exprs.size(); i < max; i++) {
@@ -21,19 +93,21 @@ void match_up(std::vector<std::tuple<Expr*, size_t, std::string>> exprs, std::ve
         g = std::gcd(g, d);
         s += d;
     }
-    if ((g > 0 && N % g != 0) || s > N) return;
-    std::vector<std::vector<size_t>> expansions;
-    std::vector<size_t> group_indices = {0};
-    auto* p = std::get<Expr*>(exprs[0])->parent;
+    if ((g > 0 && N % g != 0) || s > N) return false;
+    auto& expansions = plan.expansions;
+    auto& group_indices = plan.group_indices;
+    expansions.clear();
+    group_indices = {0};
+    auto* p = parent_of(*std::get<const Expr*>(exprs[0]));
     for (size_t i = 0, imax = exprs.size(); i < imax; i++) {
-        auto* e = std::get<Expr*>(exprs[i]);
+        auto* e = std::get<const Expr*>(exprs[i]);
         if (p && e->depth <= p->depth) {
             group_indices.push_back(i);
             break;   
         }
-        if (e->parent != p) {
+        if (parent_of(*e) != p) {
             group_indices.push_back(i);
-            p = e->parent;
+            p = parent_of(*e);
         }
         if (i + 1 == imax) {
             group_indices.push_back(i + 1);
@@ -76,219 +150,283 @@ void match_up(std::vector<std::tuple<Expr*, size_t, std::string>> exprs, std::ve
             min = 0;
             max = e->m;
         }
-        if (min == 0) {
-            candidates.push_back(0);
-        }
-        for (size_t pos = 0; pos < N; pos++) {
-            size_t count = 0;
-            std::string leaf = std::get<std::string>(exprs[i]);
-            while (match_leaf(leaf, input, pos)) {
-                pos += std::get<std::string>(exprs[i]).size();
-                count++;
-                if (count >= min && count <= max) {
-                    auto it = std::find(candidates.begin(), candidates.end(), count);
-                    if (it == candidates.end()) {
-                        it = std::lower_bound(candidates.begin(), candidates.end(), count);
-                        candidates.insert(it, count);
-                    }
-                }
-            }
+        const auto& leaf = std::get<AtomString>(exprs[i]);
+        const auto& runs = leaf_runs(leaf, N, input, scratch);
+        // Repeating an empty string yields the same text for any count, so only the least is tried
+        if (leaf.empty()) max = min;
+        // Counts from 1 up to the longest chain of the atoms, and 0 when allowed
+        size_t most = std::min(max, runs.max_chain);
+        if (min == 0) candidates.push_back(0);
+        for (size_t count = std::max<size_t>(min, 1); count <= most; count++) {
+            candidates.push_back(count);
         }
-        if (candidates.empty()) return;
-        expansions.push_back(candidates);
+        if (candidates.empty()) return false;
+        expansions.push_back(std::move(candidates));
     }
-    std::function<void(size_t depth, std::vector<size_t>&& current)> product = [&](size_t depth, std::vector<size_t>&& current) {
-        if (depth == expansions.size()) {
-            std::vector<std::tuple<Expr*, size_t, std::string>> collapsed;
-            for (size_t g = 0, gmax = group_indices.size() - 1; g < gmax; g++) {
-                size_t min_group_idx = group_indices[g];
-                size_t max_group_idx = group_indices[g + 1];
-                auto* e = std::get<Expr*>(exprs[min_group_idx]);
-                auto* p = e->parent;
-                size_t pdiv = 0;
-                std::string pleaf = "";
-                for (size_t i = min_group_idx, imax = max_group_idx; i < imax; i++) {
-                    auto leaf = std::get<std::string>(exprs[i]);
-                    auto div = std::get<size_t>(exprs[i]);
-                    auto candidate = current[i];
-                    for (size_t j = 0, jmax = candidate; j < jmax; j++) {
-                        pleaf += leaf;
-                    }
-                    pdiv += div * candidate;
-                }
-                collapsed.push_back({p, pdiv, pleaf});
-            }
-            size_t last_group_idx = group_indices[group_indices.size() - 1];
-            for (size_t i = last_group_idx, imax = exprs.size(); i < imax; i++) {
-                collapsed.push_back(exprs[i]);
-            }
-            if (exprs.size() > 1) {
-                std::vector<size_t> m = match;
-                for (size_t i = 0, imax = current.size(); i < imax; i++) {
-                    auto* e = std::get<Expr*>(exprs[i]);
-                    auto op_type = e->op_type;
-                    if (op_type != OpType::ONE && op_type != OpType::NONE) m.push_back(current[i]);
-                }
-                match_up(std::move(collapsed), groups, N, input, m, matches);
-            } else if (std::get<std::string>(collapsed[0]) == input) {
-                matches.push_back(std::move(match));
+    return true;
+}
+
+// Collapses each run of siblings into their parent, repeating the chosen counts of atoms
+void collapse_up(const std::vector<UpExpr>& exprs, const UpPlan& plan, const std::vector<size_t>& current, std::vector<UpExpr>& collapsed) {
+    const auto& group_indices = plan.group_indices;
+    for (size_t g = 0, gmax = group_indices.size() - 1; g < gmax; g++) {
+        size_t min_group_idx = group_indices[g];
+        size_t max_group_idx = group_indices[g + 1];
+        auto* e = std::get<const Expr*>(exprs[min_group_idx]);
+        auto* p = parent_of(*e);
+        size_t pdiv = 0;
+        AtomString pleaf;
+        for (size_t i = min_group_idx, imax = max_group_idx; i < imax; i++) {
+            const auto& leaf = std::get<AtomString>(exprs[i]);
+            auto div = std::get<size_t>(exprs[i]);
+            auto candidate = current[i];
+            for (size_t j = 0, jmax = candidate; j < jmax; j++) {
+                pleaf.insert(pleaf.end(), leaf.begin(), leaf.end());
             }
-            return;
+            pdiv += div * candidate;
         }
-        for (auto choice : expansions[depth]) {
-            auto next = current;
-            next.push_back(choice);
-            product(depth + 1, std::move(next));
+        collapsed.push_back({p, pdiv, std::move(pleaf)});
+    }
+    size_t last_group_idx = group_indices[group_indices.size() - 1];
+    for (size_t i = last_group_idx, imax = exprs.size(); i < imax; i++) {
+        collapsed.push_back(exprs[i]);
+    }
+}
+
+// The vars a combo assigns; only real repetitions are reported
+std::vector<size_t> up_counts(const std::vector<UpExpr>& exprs, const std::vector<size_t>& current) {
+    std::vector<size_t> m;
+    for (size_t i = 0, imax = current.size(); i < imax; i++) {
+        auto* e = std::get<const Expr*>(exprs[i]);
+        auto op_type = e->op_type;
+        if (op_type != OpType::ONE && op_type != OpType::NONE) m.push_back(current[i]);
+    }
+    return m;
+}
+
+// A fully collapsed combo is a match when its atoms read the whole input
+bool up_done(const std::vector<UpExpr>& collapsed, std::string_view input, MatchScratch& scratch) {
+    const auto& atoms = std::get<AtomString>(collapsed[0]);
+    if (atoms.size() != input.size() || !match_atoms(atoms, input, 0, scratch)) return false;
+    if (halts_on_match(scratch)) scratch.stop->store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void visit_up(const std::vector<UpExpr>& exprs, const UpPlan& plan, const std::vector<size_t>& current, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, MatchScratch& scratch, std::vector<std::vector<size_t>>& result) {
+    std::vector<UpExpr> collapsed;
+    collapse_up(exprs, plan, current, collapsed);
+    if (exprs.size() > 1) {
+        auto m = up_counts(exprs, current);
+        for (const auto& suffix : solve_up(collapsed, groups, N, input, scratch)) {
+            result.push_back(vec_cat(m, suffix));
         }
-    };
-    product(0, {});
+    } else if (up_done(collapsed, input, scratch)) {
+        result.push_back({});
+    }
 }
 
-void match_down(std::vector<Expr*> exprs, std::vector<Expr*>& groups, const size_t N, const std::string_view input, std::vector<std::vector<size_t>>& matches) {
-    bool all_leaf = std::all_of(exprs.begin(), exprs.end(), [](Expr* e) {
-        return e->children.empty();
+const std::vector<std::vector<size_t>>& solve_up(const std::vector<UpExpr>& exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, MatchScratch& scratch) {
+    auto& memo = scratch.memo;
+    auto key = up_key(exprs);
+    auto found = memo.up.find(key);
+    if (found != memo.up.end()) return found->second;
+    auto& result = memo.up[key];
+
+    UpPlan plan;
+    if (!plan_up(exprs, N, input, scratch, plan)) return result;
+    std::vector<size_t> current;
+    for_each_product(plan.expansions, current, [&](const std::vector<size_t>& current) {
+        if (stopped(scratch)) return false;
+        visit_up(exprs, plan, current, groups, N, input, scratch, result);
+        return true;
     });
-    if (all_leaf) {
-        std::vector<std::tuple<Expr*, size_t, std::string>> exprs_up;
-        bool any_active = false;
-        for (auto* e : exprs) {
-            if (e->active) {
-                any_active = true;
-                size_t div = e->group.size();
-                std::string leaf = std::string{e->group};
-                if (leaf.size() > 1 && std::isdigit(leaf[1])) {
-                    auto num = scan_number(leaf.substr(1));
-                    size_t n;
-                    std::from_chars(num.data(), num.data() + num.size(), n);
-                    size_t group_idx = n - 1;
-                    e = groups[group_idx];
-                    div = e->group.size();
-                    leaf = std::string{e->group};
-                }
-                exprs_up.push_back({e, div, leaf});
+    return result;
+}
+
+// solve_up without materializing the count vectors
+size_t count_up(const std::vector<UpExpr>& exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, MatchScratch& scratch) {
+    auto& memo = scratch.memo;
+    auto key = up_key(exprs);
+    auto found = memo.up_count.find(key);
+    if (found != memo.up_count.end()) return found->second;
+
+    size_t count = 0;
+    UpPlan plan;
+    if (plan_up(exprs, N, input, scratch, plan)) {
+        std::vector<size_t> current;
+        std::vector<UpExpr> collapsed;
+        for_each_product(plan.expansions, current, [&](const std::vector<size_t>& current) {
+            collapsed.clear();
+            collapse_up(exprs, plan, current, collapsed);
+            if (exprs.size() > 1) {
+                count += count_up(collapsed, groups, N, input, scratch);
+            } else if (up_done(collapsed, input, scratch)) {
+                count++;
+            }
+            return true;
+        });
+    }
+    memo.up_count[key] = count;
+    return count;
+}
+
+void match_up(std::vector<UpExpr> exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, std::vector<size_t> match, std::vector<std::vector<size_t>>& matches, MatchScratch& scratch) {
+    for (const auto& suffix : solve_up(exprs, groups, N, input, scratch)) {
+        matches.push_back(vec_cat(match, suffix));
+    }
+}
+
+// Leaf set handed from match_down to match_up, REF leaves swapped for the group they name.
+// Returns false when no leaf is active
+bool leaves_up(const std::vector<const Expr*>& exprs, const std::vector<const Expr*>& groups, const MatchScratch& scratch, std::vector<UpExpr>& exprs_up) {
+    bool any_active = false;
+    for (auto* e : exprs) {
+        if (scratch.active[e->self]) {
+            any_active = true;
+            if (e->group_type == GroupType::REF) {
+                size_t group_idx = ref_number(*e) - 1;
+                e = groups[group_idx];
             }
+            AtomString leaf(e->atom_count);
+            std::iota(leaf.begin(), leaf.end(), e->first_atom);
+            exprs_up.push_back({e, leaf.size(), std::move(leaf)});
         }
-        if (any_active) match_up(exprs_up, groups, N, input, {}, matches);
-        return;
     }
-    std::vector<std::vector<Expr*>> expansions;
-    size_t tail_idx = 0;
+    return any_active;
+}
+
+void plan_down(const std::vector<const Expr*>& exprs, const MatchScratch& scratch, std::vector<std::vector<const Expr*>>& expansions) {
     bool prev_alt = false;
     bool alt = false;
     for (auto* e : exprs) {
-        for (size_t i = 0, imax = e->children.size(); i < imax; i++) {
-            auto* ch = e->children[i].get();
-            if (!ch->active) continue;
+        auto chs = children(*e);
+        for (size_t i = 0, imax = chs.size(); i < imax; i++) {
+            auto* ch = &chs[i];
+            if (!scratch.active[ch->self]) continue;
             prev_alt = alt;
             alt = (ch->link_type == LinkType::ALTERNATION);
             bool cat = !(alt || prev_alt);
             bool first_alt = !prev_alt && alt;
             if (cat || first_alt) {
                 expansions.push_back({ch});
-                tail_idx++;
             } else {
-                expansions[tail_idx].push_back(ch);
+                expansions.back().push_back(ch);
             }
         }
     }
     for (auto* e : exprs) {
-        if (e->children.empty()) {
+        if (is_leaf(*e)) {
             expansions.push_back({e});
         }
     }
-    std::function<void(size_t depth, std::vector<Expr*> current)> product = [&](size_t depth, std::vector<Expr*> current) {
-        if (depth == expansions.size()) {
-            match_down(current, groups, N, input, matches);
-            return;
-        }
-        for (auto* choice : expansions[depth]) {
-            auto next = current;
-            next.push_back(choice);
-            product(depth + 1, std::move(next));
-        }
-    };
-    product(0, {});
 }
 
-bool match_leaf(std::string_view leaf, std::string_view input, size_t pos) {
-    if (pos >= input.size() || leaf.empty()) return false;
-    char target = input[pos];
-
-    if (leaf[0] == '\\') {
-        if (leaf.size() < 2) return false;
-        char esc = leaf[1];
-        switch (esc) {
-            case 'd': return std::isdigit(static_cast<unsigned char>(target));
-            case 'D': return !std::isdigit(static_cast<unsigned char>(target));
-            case 'w': return std::isalnum(static_cast<unsigned char>(target)) || target == '_';
-            case 'W': return !(std::isalnum(static_cast<unsigned char>(target)) || target == '_');
-            case 's': return std::isspace(static_cast<unsigned char>(target));
-            case 'S': return !std::isspace(static_cast<unsigned char>(target));
-            default: return target == esc;
-        }
-    } else if (leaf[0] == '[') {
-        auto it = std::adjacent_find(leaf.begin() + 1, leaf.end(), [](char a, char b) {
-            return b == ']' && (a != ':' && a != '=' && a != '.');
+bool all_leaves(const std::vector<const Expr*>& exprs) {
+    return std::all_of(exprs.begin(), exprs.end(), [](const Expr* e) {
+        return is_leaf(*e);
+    });
+}
+
+const std::vector<std::vector<size_t>>& solve_down(const std::vector<const Expr*>& exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, MatchScratch& scratch) {
+    auto& memo = scratch.memo;
+    auto key = down_key(exprs);
+    auto found = memo.down.find(key);
+    if (found != memo.down.end()) return found->second;
+    auto& result = memo.down[key];
+
+    if (all_leaves(exprs)) {
+        std::vector<UpExpr> exprs_up;
+        if (leaves_up(exprs, groups, scratch, exprs_up)) result = solve_up(exprs_up, groups, N, input, scratch);
+        return result;
+    }
+    std::vector<std::vector<const Expr*>> expansions;
+    plan_down(exprs, scratch, expansions);
+    std::vector<const Expr*> current;
+    for_each_product(expansions, current, [&](const std::vector<const Expr*>& current) {
+        if (stopped(scratch)) return false;
+        const auto& sub = solve_down(current, groups, N, input, scratch);
+        result.insert(result.end(), sub.begin(), sub.end());
+        return true;
+    });
+    return result;
+}
+
+size_t count_down(const std::vector<const Expr*>& exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, MatchScratch& scratch) {
+    auto& memo = scratch.memo;
+    auto key = down_key(exprs);
+    auto found = memo.down_count.find(key);
+    if (found != memo.down_count.end()) return found->second;
+
+    size_t count = 0;
+    if (all_leaves(exprs)) {
+        std::vector<UpExpr> exprs_up;
+        if (leaves_up(exprs, groups, scratch, exprs_up)) count = count_up(exprs_up, groups, N, input, scratch);
+    } else {
+        std::vector<std::vector<const Expr*>> expansions;
+        plan_down(exprs, scratch, expansions);
+        std::vector<const Expr*> current;
+        for_each_product(expansions, current, [&](const std::vector<const Expr*>& current) {
+            count += count_down(current, groups, N, input, scratch);
+            return true;
         });
-        if (it == leaf.end()) return false;
-        size_t close = (it - leaf.begin()) + 1;
-        std::string_view content = leaf.substr(1, close - 1);
-        bool negated = !content.empty() && content[0] == '^';
-        if (negated) content.remove_prefix(1);
-
-        bool match = false;
-        for (size_t i = 0; i < content.size();) {
-            if (i + 1 < content.size() && content[i] == '[' && content[i+1] == ':') {
-                size_t end = content.find(":]", i);
-                if (end == std::string_view::npos) break;
-                std::string_view cls = content.substr(i + 2, end - (i + 2));
-                if ((cls == "upper" && std::isupper(target)) ||
-                    (cls == "lower" && std::islower(target)) ||
-                    (cls == "alpha" && std::isalpha(target)) ||
-                    (cls == "digit" && std::isdigit(target)) ||
-                    (cls == "alnum" && std::isalnum(target)) ||
-                    (cls == "space" && std::isspace(target))) {
-                    match = true;
-                }
-                i = end + 2;
-            } else if (i + 2 < content.size() && content[i+1] == '-') {
-                if (content[i] <= target && target <= content[i+2]) match = true;
-                i += 3;
-            } else {
-                if (content[i] == target) match = true;
-                ++i;
-            }
-        }
-        return negated ? !match : match;
     }
-    return leaf[0] == target;
+    memo.down_count[key] = count;
+    return count;
+}
+
+void match_down(std::vector<const Expr*> exprs, const std::vector<const Expr*>& groups, const size_t N, const std::string_view input, std::vector<std::vector<size_t>>& matches, MatchScratch& scratch, MatchMode mode) {
+    // The early-exit modes cancel the search at the first complete match; a partial memo
+    // is never consulted again since the whole search unwinds
+    std::atomic<bool> stop{false};
+    auto* outer = scratch.stop;
+    auto outer_mode = scratch.mode;
+    scratch.mode = mode;
+    if (halts_on_match(scratch) && !outer) scratch.stop = &stop;
+    const auto& found = solve_down(exprs, groups, N, input, scratch);
+    if (mode == MatchMode::EXISTS || mode == MatchMode::FIRST) {
+        if (!found.empty()) matches.push_back(found.front());
+    } else {
+        matches.insert(matches.end(), found.begin(), found.end());
+    }
+    if (!outer && stopped(scratch)) {
+        scratch.memo.down.clear();
+        scratch.memo.up.clear();
+    }
+    scratch.stop = outer;
+    scratch.mode = outer_mode;
+}
+
+bool match_leaf(const CharClass& cls, std::string_view input, size_t pos) {
+    return pos < input.size() && cls[static_cast<unsigned char>(input[pos])];
+}
+
+bool match_leaf(std::string_view leaf, std::string_view input, size_t pos) {
+    return match_leaf(compile_leaf(leaf), input, pos);
 }
 
-bool match(Expr& expr, const Equation& eq, const std::unordered_map<std::string, size_t>& sol, std::string_view input, size_t pos) {
+bool match(const ExprTree& tree, const Expr& expr, const Equation& eq, const std::unordered_map<std::string, size_t>& sol, std::string_view input, size_t pos, const MatchScratch& scratch) {
     size_t count = 1;
-    if (!expr.xvar.empty()) {
-        auto xpos = expr.xvar.find('x');
-        auto num = expr.xvar.substr(xpos + 1);
-        size_t end = num.find_first_not_of("0123456789");
-        auto key = std::string("x") + std::string(num.substr(0, end));
-        count = sol.at(key);
+    const auto& xvar = cold(tree, expr).xvar;
+    if (xvar.type != VarType::NONE) {
+        count = sol.at(var_name(xvar));
     }
-    if (expr.children.empty()) {
+    if (is_leaf(expr)) {
         for (size_t i = 0; i < count; ++i) {
-            if (!match_leaf(expr.group, input, pos)) return false;
-            pos += expr.group.size();
+            for (size_t a = expr.first_atom, amax = a + expr.atom_count; a < amax; a++) {
+                if (!match_leaf(tree.atoms[a], input, pos++)) return false;
+            }
         }
     } else {
         for (size_t i = 0; i < count; ++i) {
-            Expr* first = nullptr;
-            for (auto& ch : expr.children) {
-                if (std::find(eq.traversed.begin(), eq.traversed.end(), ch.get()) != eq.traversed.end()) {
+            const Expr* first = nullptr;
+            for (auto& ch : children(expr)) {
+                if (std::find(eq.traversed.begin(), eq.traversed.end(), ch.self) != eq.traversed.end()) {
                     if (!first) {
-                        first = ch.get();
-                        pos = first->start;
+                        first = &ch;
+                        pos = scratch.start[first->self];
                     }
-                    if (!match(*ch, eq, sol, input, pos)) return false;
-                    pos += ch->size;
+                    if (!match(tree, ch, eq, sol, input, pos, scratch)) return false;
+                    pos += scratch.size[ch.self];
                 }
             }
         }
@@ -296,52 +434,79 @@ bool match(Expr& expr, const Equation& eq, const std::unordered_map<std::string,
     return true;
 }
 
-void get_leaves(Expr& expr, std::vector<Expr*>& leaves) {
-    if (expr.children.empty()) leaves.push_back(&expr);
-    for (auto& ch : expr.children) get_leaves(*ch, leaves);
+void get_leaves(const Expr& expr, std::vector<const Expr*>& leaves) {
+    if (is_leaf(expr)) leaves.push_back(&expr);
+    for (auto& ch : children(expr)) get_leaves(ch, leaves);
 }
 
 void set_depths(Expr* node, size_t current_depth) {
     node->depth = current_depth;
-    for (size_t i = 0, imax = node->children.size(); i < imax; i++) {
-        auto* ch = node->children[i].get();
-        set_depths(ch, current_depth + 1);
+    for (auto& ch : children(*node)) {
+        set_depths(&ch, current_depth + 1);
     }
 }
 
-void optimize_parse_tree(Expr& expr, std::string_view input) {
-    std::vector<Expr*> leaves;
+// Earliest input position matching cls; 0 when cls has bytes the scan did not cover
+size_t first_match(const CharClass& cls, const MatchScratch& scratch) {
+    if ((cls & ~scratch.scanned).any()) return 0;
+    size_t first = std::string_view::npos;
+    for_each_byte(cls, [&](size_t b) { first = std::min(first, scratch.first_byte[b]); });
+    return first;
+}
+
+// One scan over the input finds every leaf byte; a leaf stays active when its class
+// meets the bytes seen
+void optimize_parse_tree(const Expr& expr, std::string_view input, MatchScratch& scratch) {
+    std::vector<const Expr*> leaves;
     get_leaves(expr, leaves);
+    scratch.scanned.reset();
     for (auto* leaf : leaves) {
-        if (leaf->group.size() > 1 && std::isdigit(leaf->group[1])) continue;
-        bool matched = false;
-        for (size_t i = 0; i < input.size(); ++i) {
-            if (match_leaf(leaf->group, input, i)) {
-                matched = true;
-                break;
-            }
-        }
-        if (!matched) leaf->active = false;
+        if (leaf->group_type != GroupType::REF) scratch.scanned |= leaf->cls;
+    }
+    first_positions(input, scratch.scanned, scratch.first_byte);
+    CharClass seen;
+    for_each_byte(scratch.scanned, [&](size_t b) {
+        if (scratch.first_byte[b] != std::string_view::npos) seen[b] = true;
+    });
+    for (auto* leaf : leaves) {
+        if (leaf->group_type == GroupType::REF || scratch.present[leaf->self]) continue;
+        if (!(leaf->cls & seen).any()) scratch.active[leaf->self] = false;
     }
-    propagate_inactives(expr);
+    propagate_inactives(expr, scratch);
+}
+
+void reset_scratch(const ExprTree& tree, MatchScratch& scratch) {
+    size_t count = tree.nodes.size();
+    scratch.active.assign(count, true);
+    scratch.start.assign(count, 0);
+    scratch.size.assign(count, 0);
+    scratch.present.assign(count, false);
+    scratch.atoms = &tree.atoms;
+    scratch.scanned.reset();
+    scratch.memo.down.clear();
+    scratch.memo.up.clear();
+    scratch.memo.runs.clear();
+    scratch.memo.down_count.clear();
+    scratch.memo.up_count.clear();
 }
 
-void propagate_inactives(Expr& expr) {
-    for (auto& ch : expr.children) propagate_inactives(*ch);
-    if (expr.children.empty()) return;
+void propagate_inactives(const Expr& expr, MatchScratch& scratch) {
+    for (auto& ch : children(expr)) propagate_inactives(ch, scratch);
+    if (is_leaf(expr)) return;
+    auto chs = children(expr);
 
     bool active = true;
     size_t i = 0;
-    while (i < expr.children.size()) {
-        LinkType type = expr.children[i]->link_type;
+    while (i < chs.size()) {
+        LinkType type = chs[i].link_type;
         bool chain_active = (type == LinkType::ALTERNATION) ? false : true;
         while (true) {
             if (type == LinkType::ALTERNATION) {
-                if (expr.children[i]->active) chain_active = true;
+                if (scratch.active[chs[i].self]) chain_active = true;
             } else {
-                if (!expr.children[i]->active) chain_active = false;
+                if (!scratch.active[chs[i].self]) chain_active = false;
             }
-            if (expr.children[i]->link_type == LinkType::NONE) {
+            if (chs[i].link_type == LinkType::NONE) {
                 ++i;
                 break;
             }
@@ -349,13 +514,13 @@ void propagate_inactives(Expr& expr) {
         }
         if (!chain_active) active = false;
     }
-    expr.active = expr.active && active;
+    scratch.active[expr.self] = scratch.active[expr.self] && active;
 }
 
-void get_groups(Expr& expr, std::vector<Expr*>& groups) {
+// Preorder is the order groups open in, so groups[k - 1] is the group \k reads
+void get_groups(const Expr& expr, std::vector<const Expr*>& groups) {
     if (expr.ref_id > 0) groups.push_back(&expr);
-    for (size_t i = 0, imax = expr.children.size(); i < imax; i++) {
-        auto* ch = expr.children[i].get();
-        get_groups(*ch, groups);
+    for (auto& ch : children(expr)) {
+        get_groups(ch, groups);
     }
 }
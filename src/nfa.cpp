@@ -0,0 +1,322 @@
+#include "nfa.hpp"
+#include "parse.hpp"
+#include "ops.hpp"
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+// Dangling exits of a partial automaton: (state, true for out1) pairs patched later
+struct NfaFrag {
+    uint32_t start = no_node;
+    std::vector<std::pair<uint32_t, bool>> outs;
+};
+
+uint32_t add_state(Nfa& nfa, NfaOp op, uint32_t out = no_node, uint32_t out1 = no_node) {
+    nfa.states.push_back({op, 0, out, out1});
+    return static_cast<uint32_t>(nfa.states.size() - 1);
+}
+
+void patch(Nfa& nfa, const NfaFrag& frag, uint32_t target) {
+    for (auto [state, second] : frag.outs) {
+        (second ? nfa.states[state].out1 : nfa.states[state].out) = target;
+    }
+}
+
+NfaFrag empty_frag(Nfa& nfa) {
+    uint32_t s = add_state(nfa, NfaOp::EPSILON);
+    return {s, {{s, false}}};
+}
+
+NfaFrag concat_frag(Nfa& nfa, NfaFrag a, NfaFrag b) {
+    patch(nfa, a, b.start);
+    return {a.start, std::move(b.outs)};
+}
+
+NfaFrag alternate_frag(Nfa& nfa, NfaFrag a, NfaFrag b) {
+    uint32_t s = add_state(nfa, NfaOp::SPLIT, a.start, b.start);
+    a.outs.insert(a.outs.end(), b.outs.begin(), b.outs.end());
+    return {s, std::move(a.outs)};
+}
+
+NfaFrag optional_frag(Nfa& nfa, NfaFrag a) {
+    uint32_t s = add_state(nfa, NfaOp::SPLIT, a.start);
+    a.outs.push_back({s, true});
+    return {s, std::move(a.outs)};
+}
+
+// a+ loops back through a split after a; a* is that split entered first
+NfaFrag plus_frag(Nfa& nfa, NfaFrag a) {
+    uint32_t s = add_state(nfa, NfaOp::SPLIT, a.start);
+    patch(nfa, a, s);
+    return {a.start, {{s, true}}};
+}
+
+NfaFrag star_frag(Nfa& nfa, NfaFrag a) {
+    auto loop = plus_frag(nfa, std::move(a));
+    uint32_t s = loop.outs.front().first;
+    return {s, std::move(loop.outs)};
+}
+
+bool nfa_full(const Nfa& nfa) {
+    return nfa.states.size() > max_nfa_states;
+}
+
+// Per-node slots: the one a captured group records into, the one a REF reads and the
+// one a repetition counts into, no_node elsewhere; all stay empty for compile_nfa
+struct NfaBuild {
+    Nfa& nfa;
+    const ExprTree& tree;
+    std::vector<uint32_t> capture;
+    std::vector<uint32_t> ref;
+    std::vector<uint32_t> count = {};
+};
+
+uint32_t node_slot(const std::vector<uint32_t>& slots, const Expr& expr) {
+    return slots.empty() ? no_node : slots[expr.self];
+}
+
+NfaFrag build_frag(const Expr& expr, NfaBuild& build, bool apply_op);
+
+NfaFrag build_inner(const Expr& expr, NfaBuild& build) {
+    auto& nfa = build.nfa;
+    uint32_t ref = node_slot(build.ref, expr);
+    if (ref != no_node) {
+        uint32_t s = add_state(nfa, NfaOp::REF);
+        nfa.states[s].cls = ref;
+        return {s, {{s, false}}};
+    }
+    if (is_leaf(expr)) {
+        // The classes parse compiled into the tree's atoms
+        std::span<const CharClass> atoms(build.tree.atoms.data() + expr.first_atom, expr.atom_count);
+        if (atoms.empty()) return empty_frag(nfa);
+        NfaFrag frag;
+        for (const auto& cls : atoms) {
+            uint32_t s = add_state(nfa, NfaOp::CLASS);
+            nfa.states[s].cls = static_cast<uint32_t>(nfa.classes.size());
+            nfa.classes.push_back(cls);
+            NfaFrag atom{s, {{s, false}}};
+            frag = (frag.start == no_node) ? std::move(atom) : concat_frag(nfa, std::move(frag), std::move(atom));
+        }
+        return frag;
+    }
+    // Children concatenate; a run of alternation links picks one member
+    NfaFrag frag;
+    NfaFrag alt_run;
+    bool prev_alt = false;
+    bool alt = false;
+    for (const auto& ch : children(expr)) {
+        if (nfa_full(nfa)) break;
+        prev_alt = alt;
+        alt = (ch.link_type == LinkType::ALTERNATION);
+        auto ch_frag = build_frag(ch, build, true);
+        alt_run = prev_alt ? alternate_frag(nfa, std::move(alt_run), std::move(ch_frag)) : std::move(ch_frag);
+        if (alt) continue;
+        frag = (frag.start == no_node) ? std::move(alt_run) : concat_frag(nfa, std::move(frag), std::move(alt_run));
+    }
+    if (alt) frag = (frag.start == no_node) ? std::move(alt_run) : concat_frag(nfa, std::move(frag), std::move(alt_run));
+    return (frag.start == no_node) ? empty_frag(nfa) : frag;
+}
+
+// One pass over the node, bracketed by OPEN/CLOSE when a REF reads it, so the last
+// repetition's span is the one kept
+NfaFrag build_content(const Expr& expr, NfaBuild& build) {
+    auto& nfa = build.nfa;
+    uint32_t slot = node_slot(build.capture, expr);
+    if (slot == no_node) return build_inner(expr, build);
+    uint32_t open = add_state(nfa, NfaOp::OPEN);
+    nfa.states[open].cls = slot;
+    auto frag = concat_frag(nfa, {open, {{open, false}}}, build_inner(expr, build));
+    uint32_t close = add_state(nfa, NfaOp::CLOSE);
+    nfa.states[close].cls = slot;
+    return concat_frag(nfa, std::move(frag), {close, {{close, false}}});
+}
+
+// One pass of a repetition, led by the state counting it when the node has a count slot
+NfaFrag build_pass(const Expr& expr, NfaBuild& build, NfaOp count_op) {
+    auto& nfa = build.nfa;
+    uint32_t slot = node_slot(build.count, expr);
+    if (slot == no_node) return build_content(expr, build);
+    uint32_t s = add_state(nfa, count_op);
+    nfa.states[s].cls = slot;
+    return concat_frag(nfa, {s, {{s, false}}}, build_content(expr, build));
+}
+
+// Counted repetitions are expanded: n copies, then m - n nested optionals or a star
+NfaFrag build_repeat(const Expr& expr, NfaBuild& build) {
+    auto& nfa = build.nfa;
+    size_t n = expr.n;
+    size_t m = expr.m;
+    if (m == 0) return empty_frag(nfa);
+    NfaFrag frag;
+    auto append = [&](NfaFrag next) {
+        frag = (frag.start == no_node) ? std::move(next) : concat_frag(nfa, std::move(frag), std::move(next));
+    };
+    for (size_t i = 0; i + 1 < n && !nfa_full(nfa); i++) {
+        append(build_pass(expr, build, NfaOp::COUNT));
+    }
+    if (m == unbounded) {
+        auto loop = build_pass(expr, build, NfaOp::REPEAT);
+        append(n > 0 ? plus_frag(nfa, std::move(loop)) : star_frag(nfa, std::move(loop)));
+        return frag;
+    }
+    if (n > 0) append(build_pass(expr, build, NfaOp::COUNT));
+    NfaFrag tail;
+    for (size_t i = n; i < m && !nfa_full(nfa); i++) {
+        auto copy = build_pass(expr, build, NfaOp::COUNT);
+        tail = optional_frag(nfa, (tail.start == no_node) ? std::move(copy) : concat_frag(nfa, std::move(copy), std::move(tail)));
+    }
+    if (tail.start != no_node) append(std::move(tail));
+    return frag;
+}
+
+NfaFrag build_frag(const Expr& expr, NfaBuild& build, bool apply_op) {
+    auto& nfa = build.nfa;
+    if (!apply_op || expr.op_type == OpType::NONE || expr.op_type == OpType::ONE) return build_content(expr, build);
+    uint32_t slot = node_slot(build.count, expr);
+    if (slot == no_node) return build_repeat(expr, build);
+    uint32_t reset = add_state(nfa, NfaOp::RESET);
+    nfa.states[reset].cls = slot;
+    return concat_frag(nfa, {reset, {{reset, false}}}, build_repeat(expr, build));
+}
+
+// Partition refinement: bytes stay together while every class agrees on them
+void compute_byte_classes(Nfa& nfa) {
+    nfa.byte_class.fill(0);
+    size_t count = 1;
+    // Refined ids by (current id, in class), 0 while unassigned
+    std::array<uint16_t, 512> ids;
+    for (const auto& cls : nfa.classes) {
+        ids.fill(0);
+        count = 0;
+        for (size_t b = 0; b < 256; b++) {
+            auto& id = ids[2 * nfa.byte_class[b] + cls[b]];
+            if (id == 0) id = static_cast<uint16_t>(++count);
+            nfa.byte_class[b] = static_cast<uint8_t>(id - 1);
+        }
+    }
+    nfa.rep.assign(count, 0);
+    for (size_t b = 256; b-- > 0;) {
+        nfa.rep[nfa.byte_class[b]] = static_cast<uint8_t>(b);
+    }
+}
+
+bool valid_node(const Expr& e) {
+    bool group = is_valid_group(e.group_type) || e.group_type == GroupType::EMPTY || e.group_type == GroupType::REF;
+    bool link = is_valid_link(e.link_type) || e.link_type == LinkType::NONE;
+    return group && link && is_valid_op(e.op_type);
+}
+
+bool is_regular(const ExprTree& tree) {
+    return std::all_of(tree.nodes.begin(), tree.nodes.end(), [](const Expr& e) {
+        return valid_node(e) && !is_ref(e);
+    });
+}
+
+void compute_first(Nfa& nfa) {
+    std::vector<uint8_t> seen(nfa.states.size(), false);
+    std::vector<uint32_t> stack{nfa.start};
+    while (!stack.empty()) {
+        uint32_t s = stack.back();
+        stack.pop_back();
+        if (s == no_node || seen[s]) continue;
+        seen[s] = true;
+        const auto& st = nfa.states[s];
+        switch (st.op) {
+            case NfaOp::CLASS: nfa.first |= nfa.classes[st.cls]; break;
+            case NfaOp::SPLIT: stack.push_back(st.out1); stack.push_back(st.out); break;
+            case NfaOp::EPSILON: case NfaOp::OPEN: case NfaOp::CLOSE: case NfaOp::RESET: case NfaOp::COUNT: case NfaOp::REPEAT:
+                stack.push_back(st.out);
+                break;
+            case NfaOp::MATCH: case NfaOp::REF: nfa.starts_anywhere = true; break;
+        }
+    }
+}
+
+uint64_t next_nfa_id() {
+    static std::atomic<uint64_t> next_id{1};
+    return next_id++;
+}
+
+bool build_nfa(const ExprTree& tree, NfaBuild& build) {
+    auto& nfa = build.nfa;
+    // The root's op is also carried by its only child, see gen_lengths
+    auto frag = build_frag(root(tree), build, false);
+    if (nfa_full(nfa)) return false;
+    uint32_t match = add_state(nfa, NfaOp::MATCH);
+    patch(nfa, frag, match);
+    nfa.start = frag.start;
+    compute_byte_classes(nfa);
+    compute_first(nfa);
+    nfa.id = next_nfa_id();
+    return true;
+}
+
+bool compile_nfa(const ExprTree& tree, Nfa& nfa) {
+    nfa = {};
+    if (tree.nodes.empty() || !is_regular(tree)) return false;
+    NfaBuild build{nfa, tree, {}, {}};
+    return build_nfa(tree, build);
+}
+
+uint32_t capture_slot(NfaBuild& build, uint32_t node) {
+    if (build.capture[node] == no_node) {
+        build.capture[node] = static_cast<uint32_t>(build.nfa.slot_node.size());
+        build.nfa.slot_node.push_back(node);
+    }
+    return build.capture[node];
+}
+
+// Slots for the groups REFs read, and for every group when every_group is set
+bool assign_slots(const ExprTree& tree, const std::vector<const Expr*>& groups, NfaBuild& build, bool every_group, bool& has_ref) {
+    if (every_group) {
+        for (auto* group : groups) capture_slot(build, group->self);
+    }
+    has_ref = false;
+    for (const auto& e : tree.nodes) {
+        if (!is_ref(e)) continue;
+        size_t n = ref_number(e);
+        if (n == 0 || n > groups.size()) return false;
+        build.ref[e.self] = capture_slot(build, groups[n - 1]->self);
+        has_ref = true;
+    }
+    return true;
+}
+
+bool valid_tree(const ExprTree& tree) {
+    return !tree.nodes.empty() && std::all_of(tree.nodes.begin(), tree.nodes.end(), valid_node);
+}
+
+bool compile_slots(const ExprTree& tree, const std::vector<const Expr*>& groups, Nfa& nfa, bool every_group) {
+    nfa = {};
+    if (!valid_tree(tree)) return false;
+    NfaBuild build{nfa, tree, std::vector<uint32_t>(tree.nodes.size(), no_node), std::vector<uint32_t>(tree.nodes.size(), no_node)};
+    bool has_ref = false;
+    if (!assign_slots(tree, groups, build, every_group, has_ref)) return false;
+    return (has_ref || every_group) && build_nfa(tree, build);
+}
+
+bool compile_ref_nfa(const ExprTree& tree, const std::vector<const Expr*>& groups, Nfa& nfa) {
+    return compile_slots(tree, groups, nfa, false);
+}
+
+bool compile_capture_nfa(const ExprTree& tree, const std::vector<const Expr*>& groups, Nfa& nfa) {
+    return compile_slots(tree, groups, nfa, true);
+}
+
+bool compile_count_nfa(const ExprTree& tree, const std::vector<const Expr*>& groups, Nfa& nfa) {
+    nfa = {};
+    if (!valid_tree(tree)) return false;
+    size_t size = tree.nodes.size();
+    NfaBuild build{nfa, tree, std::vector<uint32_t>(size, no_node), std::vector<uint32_t>(size, no_node), std::vector<uint32_t>(size, no_node)};
+    bool has_ref = false;
+    if (!assign_slots(tree, groups, build, false, has_ref)) return false;
+    // The root's repetition is its only child's, see build_nfa
+    for (const auto& e : tree.nodes) {
+        if (e.parent != no_node && e.op_type != OpType::NONE && e.op_type != OpType::ONE) nfa.count_node.push_back(e.self);
+    }
+    std::sort(nfa.count_node.begin(), nfa.count_node.end(), [&](uint32_t a, uint32_t b) {
+        return cold(tree, tree.nodes[a]).xvar.id < cold(tree, tree.nodes[b]).xvar.id;
+    });
+    for (size_t slot = 0; slot < nfa.count_node.size(); slot++) build.count[nfa.count_node[slot]] = static_cast<uint32_t>(slot);
+    return build_nfa(tree, build);
+}
@@ -1,93 +1,39 @@
 #include "parse.hpp"
 #include "ops.hpp"
 #include <algorithm>
-#include <charconv>
 
 using namespace std::literals::string_view_literals;
 
-std::string_view scan_number(std::string_view input) {
-    size_t i = 0;
-    while (i < input.size() && std::isdigit(input[i])) i++;
-    return input.substr(0, i);
+// The parser keeps a wrapped group holding only a back-reference, e.g. (\1), as one
+// leaf with the group's type, so the reference is recognized from the text as well
+bool is_ref(const Expr& expr) {
+    if (expr.group_type == GroupType::REF) return true;
+    if (!is_leaf(expr) || check_group(expr.group) != GroupType::REF) return false;
+    return 1 + scan_number(expr.group.substr(1)).size() == expr.group.size();
 }
 
-bool is_valid_group(GroupType type) {
-    return type == GroupType::IMPLICIT ||
-           type == GroupType::CAPTURE ||
-           type == GroupType::NONCAPTURE ||
-           type == GroupType::BRACKET ||
-           type == GroupType::BRACKET_NEGATED;
+size_t ref_number(const Expr& expr) {
+    auto num = scan_number(expr.group.substr(1));
+    size_t n = 0;
+    read_count(num, n);
+    return n;
 }
 
-GroupType check_group(std::string_view input) {
-    if (input.empty()) return GroupType::EMPTY;
-    auto c1 = input[0];
-    auto c2 = input.size() > 1 ? input[1] : '\0';
-    auto c3 = input.size() > 2 ? input[2] : '\0';
-    if ("{|?*+"sv.contains(c1)) return GroupType::INVALID_GROUP_START;
-    if (c1 == '(') return (c2 == '?' && c3 == ':') ? GroupType::NONCAPTURE : GroupType::CAPTURE;
-    if (c1 == '[') return (c2 == '^') ? GroupType::BRACKET_NEGATED : GroupType::BRACKET;
-    if (c1 == '\\' && std::isdigit(c2)) return GroupType::REF;
-    return GroupType::IMPLICIT;
-}
-
-bool is_wrapped(GroupType type) {
-    return type == GroupType::CAPTURE || type == GroupType::NONCAPTURE;
-}
-
-bool is_bracketed(GroupType type) {
-    return type == GroupType::BRACKET || type == GroupType::BRACKET_NEGATED;
-}
-
-std::string_view scan_group_implicit(std::string_view input) {
-    constexpr std::string_view end = "(){|?*+";
-    constexpr std::string_view split = "?*+{";
-    size_t pos = input.find_first_of(end);
-    if (pos == std::string_view::npos) return input;
-    return input.substr(0, (split.contains(input[pos]) && pos > 1) ? pos - 1 : pos);
-}
-
-std::string_view scan_group_wrapped(std::string_view input, GroupType& type) {
-    int balance = 0;
-    size_t i = 0;
-    for (; i < input.size(); i++) {
-        if (input[i] == '(') balance++;
-        else if (input[i] == ')') balance--;
-        if (balance == 0) break;
-    }
-    if (balance != 0) {
-        type = GroupType::INVALID_GROUP_UNMATCHED;
-        return "";
+size_t count_reached(const Expr& expr, size_t& groups, bool& resolved) {
+    size_t count = 1;
+    if (expr.ref_id > 0) groups++;
+    if (is_ref(expr)) {
+        size_t n = ref_number(expr);
+        resolved = resolved && n > 0 && n <= groups;
     }
-    return input.substr(0, i + 1);
+    for (auto& ch : children(expr)) count += count_reached(ch, groups, resolved);
+    return count;
 }
 
-std::string_view unwrap_group(std::string_view input) {
-    return (input.size() >= 2) ? input.substr(1, input.size() - 2) : "";
-}
-
-std::string_view scan_ref(std::string_view input, GroupType& type, size_t ref_id) {
-    auto num = scan_number(input.substr(1));
-    size_t n;
-    std::from_chars(num.data(), num.data() + num.size(), n);
-    if (n > ref_id) {
-        type = GroupType::INVALID_REF_ID;
-        return "";
-    }
-    return input.substr(0, 1 + num.size());
-}
-
-std::string_view scan_bracket(std::string_view input, GroupType& type) {
-    constexpr std::string_view special = ":.=";
-    auto end_it = std::adjacent_find(input.begin(), input.end(), [=](char a, char b) { return !special.contains(a) && b == ']'; });
-    bool closed = (end_it != input.end());
-    if (!closed) {
-        type = GroupType::INVALID_BRACKET_UNMATCHED;
-        return "";
-    }
-    ++end_it;
-    size_t end_pos = std::distance(input.begin(), end_it);
-    return input.substr(0, end_pos);
+bool refs_resolved(const ExprTree& tree) {
+    size_t groups = 0;
+    bool resolved = true;
+    return count_reached(root(tree), groups, resolved) == tree.nodes.size() && resolved;
 }
 
 std::string_view scan_bracket_inner(std::string_view input, GroupType& type) {
@@ -127,72 +73,70 @@ bool is_valid_bracket_class(std::string_view input) {
 bool is_valid_bracket_collation(std::string_view) { return true; }
 bool is_valid_bracket_equivalence(std::string_view) { return true; }
 
-std::string_view scan_bracket_char(std::string_view input, GroupType& type) {
-    if (input.empty()) return "";
-    if (input[0] != '\\') return input.substr(0, 1);
-    if (input.size() < 2) {
-        type = GroupType::INVALID_BRACKET_ESCAPE;
-        return "";
-    }
-    if (input.substr(0, 2) != "\\x") return input.substr(0, 2);
-    if (input.size() < 4) {
-        type = GroupType::INVALID_BRACKET_HEX;
-        return "";
-    }
-    auto hex = input.substr(2, 2);
-    if (!std::all_of(hex.begin(), hex.end(), ::isxdigit)) {
-        type = GroupType::INVALID_BRACKET_HEX;
-        return "";
-    }
-    return input.substr(0, 4);
+CharClass compile_escape(char esc) {
+    return escape_class<CharClass>(esc);
 }
 
-char eval_bracket_char(std::string_view input) {
-    if (input.empty()) return '\0';
-    if (input.substr(0, 2) == "\\x") {
-        char c = 0;
-        std::from_chars(input.data() + 2, input.data() + 4, c, 16);
-        return c;
-    }
-    if (input[0] == '\\') {
-        switch (input[1]) {
-            case 't': return '\t';
-            case 'n': return '\n';
-            case 'r': return '\r';
-            case 'f': return '\f';
-            case 'v': return '\v';
-            case 'a': return '\a';
-            case 'b': return '\b';
-            case '\\': return '\\';
-            case '\'': return '\'';
-            case '"': return '"';
-            default: return input[1];
-        }
+CharClass compile_posix_class(std::string_view name) {
+    return posix_class<CharClass>(name);
+}
+
+CharClass compile_bracket(std::string_view input) {
+    return bracket_class<CharClass>(input);
+}
+
+CharClass compile_leaf(std::string_view leaf) {
+    return leaf_class<CharClass>(leaf);
+}
+
+// One class per atom of the leaf text, for the automaton engines
+void compile_atoms(std::string_view leaf, std::vector<CharClass>& atoms) {
+    while (!leaf.empty()) {
+        auto atom = scan_atom(leaf);
+        atoms.push_back(compile_leaf(atom));
+        leaf.remove_prefix(atom.size());
     }
-    return input[0];
 }
 
-std::string_view scan_group(std::string_view input, GroupType& type, size_t ref_id) {
-    type = check_group(input);
-    if (type == GroupType::REF) return scan_ref(input, type, ref_id);
-    if (is_bracketed(type)) return scan_bracket(input, type);
-    if (is_wrapped(type)) return scan_group_wrapped(input, type);
-    return scan_group_implicit(input);
+void index_atoms(ExprTree& tree) {
+    tree.atoms.clear();
+    for (auto& expr : tree.nodes) {
+        expr.first_atom = static_cast<uint32_t>(tree.atoms.size());
+        if (is_leaf(expr) && !is_ref(expr)) compile_atoms(expr.group, tree.atoms);
+        expr.atom_count = static_cast<uint32_t>(tree.atoms.size() - expr.first_atom);
+    }
 }
 
-std::unique_ptr<Expr> parse(std::string_view input) {
-    size_t ref_id = 1;
+ExprTree parse(std::string_view input) {
+    size_t ref_id = 0;
     return parse(input, ref_id);
 }
 
-std::unique_ptr<Expr> parse(std::string_view input, size_t& ref_id) {
-    std::unique_ptr<Expr> root;
-    size_t local_ref_id = ref_id;
+ExprTree parse(std::string_view input, size_t& ref_id) {
+    ExprTree tree;
+    add_nodes(tree, 1);
+    parse(tree, 0, input, ref_id);
+    index_atoms(tree);
+    return tree;
+}
+
+struct GroupToken {
+    GroupType group_type;
+    OpType op_type;
+    LinkType link_type;
+    std::string_view scan;
+    std::string_view op;
+    std::string_view link;
+};
+
+void parse(ExprTree& tree, uint32_t node, std::string_view input, size_t& ref_id) {
     GroupType group_type;
     OpType op_type;
     LinkType link_type;
 
-    auto scan = scan_group(input, group_type, ref_id);
+    // References are checked against ref_id below, once the preceding siblings are parsed
+    size_t any_ref_id = std::numeric_limits<size_t>::max();
+    auto scan = scan_group(input, group_type, any_ref_id);
     auto rest = input.substr(scan.size());
     auto op = scan_op(rest, op_type);
     auto link = scan_link(rest.substr(op.size()), link_type);
@@ -200,50 +144,71 @@ std::unique_ptr<Expr> parse(std::string_view input, size_t& ref_id) {
     bool wrapped = is_wrapped(group_type);
     auto empty_op = ""sv;
     auto empty_link = ""sv;
-    size_t no_ref_id = 0;
-    size_t zero_idx = 0;
-    if (group_type == GroupType::CAPTURE) ref_id++;
+    uint32_t no_ref_id = 0;
+    uint32_t zero_idx = 0;
+    uint32_t zero_depth = 0;
 
+    auto& expr = tree.nodes[node];
     if (!wrapped && scan.size() == input.size()) {
-        size_t div = scan.size();
-        return std::make_unique<Expr>(group_type, OpType::NONE, LinkType::NONE, input, empty_op, empty_link, no_ref_id, zero_idx, div);
+        expr = Expr(group_type, OpType::NONE, LinkType::NONE, input, empty_op, empty_link, no_ref_id, zero_idx, zero_depth, node);
+        expr.cls = compile_leaf(input);
+        return;
     } else if (wrapped && scan.size() + op.size() == input.size()) {
-        root = std::make_unique<Expr>(group_type, op_type, LinkType::NONE, scan, op, empty_link, local_ref_id);
-        set_range(*root);
+        expr = Expr(group_type, op_type, LinkType::NONE, scan, op, empty_link, no_ref_id, zero_idx, zero_depth, node);
+        set_range(expr);
     } else {
-        root = std::make_unique<Expr>(GroupType::IMPLICIT, OpType::ONE, LinkType::NONE, input, empty_op, empty_link, no_ref_id);
+        expr = Expr(GroupType::IMPLICIT, OpType::ONE, LinkType::NONE, input, empty_op, empty_link, no_ref_id, zero_idx, zero_depth, node);
     }
-    
-    size_t idx = 0;
-    while (!scan.empty()) {
-        auto maybe_unwrap = !wrapped ? scan : unwrap_group(scan);
-        auto lhs = parse(maybe_unwrap, ref_id);
-
-        lhs->parent = root.get();
-        lhs->idx = idx++;
-        lhs->group = maybe_unwrap;
-        lhs->group_type = group_type;
-        lhs->op = op;
-        lhs->op_type = op_type;
-        lhs->link = link;
-        lhs->link_type = link_type;
-        set_range(*lhs);
-
-        if (lhs->group_type == GroupType::CAPTURE) lhs->ref_id = local_ref_id;
-        root->children.push_back(std::move(lhs));
 
+    // Scan the whole level first so the children can be allocated contiguously
+    std::vector<GroupToken> tokens;
+    while (!scan.empty()) {
+        tokens.push_back({group_type, op_type, link_type, scan, op, link});
         rest.remove_prefix(op.size() + link.size());
-        scan = scan_group(rest, group_type, ref_id);
+        scan = scan_group(rest, group_type, any_ref_id);
         rest = rest.substr(scan.size());
         op = scan_op(rest, op_type);
         link = scan_link(rest.substr(op.size()), link_type);
-        wrapped = is_wrapped(group_type);
 
         if (!is_valid_group(group_type)) {}
         if (!is_valid_op(op_type)) {}
         if (!is_valid_link(link_type)) {}
     }
 
-    return root;
+    uint32_t first = add_nodes(tree, tokens.size());
+    tree.nodes[node].first_child = first;
+    tree.nodes[node].child_count = static_cast<uint32_t>(tokens.size());
+
+    // Groups are numbered in the order they open, a group before the ones it contains;
+    // a level is cut at a reference to a group not opened yet
+    for (uint32_t idx = 0, imax = tokens.size(); idx < imax; idx++) {
+        const auto& token = tokens[idx];
+        if (token.group_type == GroupType::REF) {
+            GroupType checked = token.group_type;
+            scan_ref(token.scan, checked, ref_id);
+            if (checked == GroupType::INVALID_REF_ID) {
+                tree.nodes[node].child_count = idx;
+                break;
+            }
+        }
+        uint32_t number = 0;
+        if (token.group_type == GroupType::CAPTURE) number = static_cast<uint32_t>(++ref_id);
+        wrapped = is_wrapped(token.group_type);
+        auto maybe_unwrap = !wrapped ? token.scan : unwrap_group(token.scan);
+        uint32_t ch = first + idx;
+        parse(tree, ch, maybe_unwrap, ref_id);
+
+        auto& lhs = tree.nodes[ch];
+        lhs.parent = node;
+        lhs.idx = idx;
+        lhs.group = maybe_unwrap;
+        lhs.group_type = token.group_type;
+        lhs.op = token.op;
+        lhs.op_type = token.op_type;
+        lhs.link = token.link;
+        lhs.link_type = token.link_type;
+        lhs.ref_id = number;
+        set_range(lhs);
+        if (is_leaf(lhs)) lhs.cls = compile_leaf(lhs.group);
+    }
 }
-
@@ -0,0 +1,112 @@
+#include "pattern.hpp"
+#include "parse.hpp"
+#include "frags.hpp"
+#include "simd.hpp"
+#include "dfa.hpp"
+
+std::unique_ptr<const CompiledPattern> compile_pattern(std::string_view regex) {
+    // The tree holds views into text, so it is parsed only once text has its final address
+    auto pattern = std::make_unique<CompiledPattern>();
+    pattern->text = std::string{regex};
+    pattern->tree = parse(pattern->text);
+    if (pattern->tree.nodes.empty() || !refs_resolved(pattern->tree)) return nullptr;
+
+    gen_frags(pattern->tree);
+    gen_lengths(pattern->tree);
+    set_depths(&root(pattern->tree));
+    compile_engines(*pattern);
+    return pattern;
+}
+
+void compile_bit_parallel(CompiledPattern& pattern) {
+    pattern.bit_parallel = false;
+    pattern.glushkov = nullptr;
+    if (!pattern.regular) return;
+    auto glushkov = std::make_unique<Glushkov>();
+    pattern.bit_parallel = compile_glushkov(pattern.nfa, *glushkov);
+    if (pattern.bit_parallel) pattern.glushkov = std::move(glushkov);
+}
+
+void compile_engines(CompiledPattern& pattern) {
+    get_groups(root(pattern.tree), pattern.groups);
+    extract_literals(pattern.tree, pattern.literals);
+    pattern.regular = compile_nfa(pattern.tree, pattern.nfa);
+    compile_bit_parallel(pattern);
+    pattern.backrefs = !pattern.regular && compile_ref_nfa(pattern.tree, pattern.groups, pattern.nfa);
+    pattern.searchable = compile_capture_nfa(pattern.tree, pattern.groups, pattern.captures);
+    pattern.countable = (pattern.regular || pattern.backrefs) && compile_count_nfa(pattern.tree, pattern.groups, pattern.counts);
+}
+
+// Heap bytes only; the struct itself is counted by its owner
+size_t nfa_bytes(const Nfa& nfa) {
+    return nfa.states.capacity() * sizeof(NfaState) + nfa.classes.capacity() * sizeof(CharClass) + nfa.rep.capacity() + (nfa.slot_node.capacity() + nfa.count_node.capacity()) * sizeof(uint32_t);
+}
+
+size_t string_bytes(const std::string& text) {
+    // Short strings live inside the object
+    return (text.capacity() > std::string{}.capacity()) ? text.capacity() + 1 : 0;
+}
+
+size_t pattern_bytes(const CompiledPattern& pattern) {
+    size_t bytes = sizeof(CompiledPattern) + string_bytes(pattern.text);
+    bytes += pattern.tree.nodes.capacity() * sizeof(Expr) + pattern.tree.cold.capacity() * sizeof(ExprCold);
+    bytes += pattern.tree.terms.capacity() * sizeof(FragTerm) + pattern.tree.term_vars.capacity() * sizeof(Var);
+    bytes += pattern.tree.atoms.capacity() * sizeof(CharClass);
+    bytes += pattern.groups.capacity() * sizeof(const Expr*);
+    bytes += pattern.literals.capacity() * sizeof(RequiredLiteral);
+    for (const auto& literal : pattern.literals) {
+        bytes += string_bytes(literal.text) + literal.leaves.capacity() * sizeof(uint32_t);
+    }
+    if (pattern.glushkov) bytes += sizeof(Glushkov);
+    return bytes + nfa_bytes(pattern.nfa) + nfa_bytes(pattern.captures) + nfa_bytes(pattern.counts);
+}
+
+// Leaves covered by a literal hit are marked present, so optimize_parse_tree skips their scan
+bool admits_input(const CompiledPattern& pattern, std::string_view input, MatchScratch& scratch) {
+    if (!admits_length(cold(pattern.tree, root(pattern.tree)).lengths, input.size())) return false;
+    for (const auto& literal : pattern.literals) {
+        if (find_bytes(input, literal.text) == std::string_view::npos) return false;
+        for (auto leaf : literal.leaves) scratch.present[leaf] = true;
+    }
+    return true;
+}
+
+bool prepare_scratch(const CompiledPattern& pattern, std::string_view input, MatchScratch& scratch) {
+    reset_scratch(pattern.tree, scratch);
+    if (!admits_input(pattern, input, scratch)) return false;
+    optimize_parse_tree(root(pattern.tree), input, scratch);
+    return true;
+}
+
+// Whole-input verdict of a regular or back-referencing pattern's automaton
+bool automaton_match(const CompiledPattern& pattern, std::string_view input, MatchScratch& scratch) {
+    if (pattern.backrefs) return ref_match(pattern.nfa, input, scratch);
+    return pattern.bit_parallel ? glushkov_match(*pattern.glushkov, input) : dfa_match(pattern.nfa, scratch.dfa, input);
+}
+
+MatchResult query_pattern(const CompiledPattern& pattern, std::string_view input, MatchScratch& scratch, MatchMode mode) {
+    MatchResult result;
+    // The automata decide whether a pattern matches; the equation search cannot follow
+    // every derivation nor compare a reference with its group's text, so it only serves
+    // patterns no automaton takes
+    if (pattern.regular || pattern.backrefs) {
+        reset_scratch(pattern.tree, scratch);
+        result.found = admits_input(pattern, input, scratch) && automaton_match(pattern, input, scratch);
+        result.count = result.found;
+        if (result.found && mode != MatchMode::EXISTS && pattern.countable) {
+            result.count = derive_counts(pattern.counts, input, mode, result.matches);
+        }
+        return result;
+    }
+    if (!prepare_scratch(pattern, input, scratch)) return result;
+    const auto& expr = root(pattern.tree);
+    if (mode == MatchMode::COUNT) {
+        result.count = count_down({&expr}, pattern.groups, input.size(), input, scratch);
+    } else {
+        match_down({&expr}, pattern.groups, input.size(), input, result.matches, scratch, mode);
+        result.count = result.matches.size();
+        if (mode == MatchMode::EXISTS) result.matches.clear();
+    }
+    result.found = result.count > 0;
+    return result;
+}
@@ -0,0 +1,58 @@
+#include "pattern_cache.hpp"
+
+PatternCache::PatternCache(size_t max_bytes) : max_bytes(max_bytes) {}
+
+std::shared_ptr<const CompiledPattern> PatternCache::get(std::string_view regex) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = index.find(regex);
+        if (found != index.end()) {
+            order.splice(order.begin(), order, found->second);
+            hit_count++;
+            return found->second->pattern;
+        }
+    }
+    miss_count++;
+    std::shared_ptr<const CompiledPattern> pattern = compile_pattern(regex);
+    if (!pattern) return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = index.find(regex);
+    if (found != index.end()) {
+        order.splice(order.begin(), order, found->second);
+        return found->second->pattern;
+    }
+    size_t bytes = pattern_bytes(*pattern);
+    order.push_front({std::string{regex}, pattern, bytes});
+    index.emplace(order.front().regex, order.begin());
+    used_bytes += bytes;
+    evict();
+    return pattern;
+}
+
+void PatternCache::evict() {
+    while (used_bytes > max_bytes && order.size() > 1) {
+        auto& oldest = order.back();
+        used_bytes -= oldest.bytes;
+        index.erase(oldest.regex);
+        order.pop_back();
+    }
+}
+
+size_t PatternCache::hits() const {
+    return hit_count;
+}
+
+size_t PatternCache::misses() const {
+    return miss_count;
+}
+
+size_t PatternCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return order.size();
+}
+
+size_t PatternCache::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return used_bytes;
+}
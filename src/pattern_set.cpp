@@ -0,0 +1,84 @@
+#include "pattern_set.hpp"
+#include "frags.hpp"
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <utility>
+
+std::unique_ptr<const PatternSet> compile_pattern_set(const std::vector<std::string>& regexes, PatternCache* cache) {
+    std::vector<std::shared_ptr<const CompiledPattern>> patterns;
+    for (const auto& regex : regexes) {
+        std::shared_ptr<const CompiledPattern> pattern = cache ? cache->get(regex) : compile_pattern(regex);
+        if (!pattern) return nullptr;
+        patterns.push_back(std::move(pattern));
+    }
+    return build_pattern_set(std::move(patterns));
+}
+
+std::unique_ptr<const PatternSet> build_pattern_set(std::vector<std::shared_ptr<const CompiledPattern>> patterns) {
+    static std::atomic<uint64_t> next_serial{1};
+    auto set = std::make_unique<PatternSet>();
+    set->serial = next_serial++;
+    std::vector<std::string> texts;
+    std::unordered_map<std::string, uint32_t> ids;
+    for (uint32_t id = 0; id < patterns.size(); id++) {
+        uint32_t required = 0;
+        for (const auto& literal : patterns[id]->literals) {
+            auto [it, added] = ids.emplace(literal.text, static_cast<uint32_t>(texts.size()));
+            if (added) {
+                texts.push_back(literal.text);
+                set->owners.emplace_back();
+            }
+            // A literal extracted twice from one pattern counts once
+            auto& owners = set->owners[it->second];
+            if (!owners.empty() && owners.back() == id) continue;
+            owners.push_back(id);
+            required++;
+        }
+        if (required == 0) set->unfiltered.push_back(id);
+        set->required.push_back(required);
+    }
+    set->patterns = std::move(patterns);
+    build_literal_automaton(texts, set->literals);
+    return set;
+}
+
+// Cheap rejections before a pattern's engine runs: its length set, and for the
+// automaton engines the bytes a match can begin with
+bool admits_start(const CompiledPattern& pattern, std::string_view input) {
+    if (!admits_length(cold(pattern.tree, root(pattern.tree)).lengths, input.size())) return false;
+    if (input.empty() || !(pattern.regular || pattern.backrefs) || pattern.nfa.starts_anywhere) return true;
+    return pattern.nfa.first[static_cast<unsigned char>(input.front())];
+}
+
+void match_set(const PatternSet& set, std::string_view input, PatternSetScratch& scratch, std::vector<uint32_t>& ids) {
+    ids.clear();
+    size_t count = set.patterns.size();
+    if (scratch.set_serial != set.serial) {
+        scratch.set_serial = set.serial;
+        scratch.dfas.assign(count, {});
+        scratch.hits.assign(count, 0);
+        scratch.reported.assign(set.literals.literal.size(), false);
+    }
+    scratch.found.clear();
+    find_literals(set.literals, input, scratch.reported, scratch.found);
+    auto& candidates = scratch.candidates;
+    candidates.assign(set.unfiltered.begin(), set.unfiltered.end());
+    for (auto literal : scratch.found) {
+        for (auto id : set.owners[literal]) {
+            if (++scratch.hits[id] == set.required[id]) candidates.push_back(id);
+        }
+    }
+    for (auto literal : scratch.found) {
+        for (auto id : set.owners[literal]) scratch.hits[id] = 0;
+    }
+    std::sort(candidates.begin(), candidates.end());
+    for (auto id : candidates) {
+        const auto& pattern = *set.patterns[id];
+        if (!admits_start(pattern, input)) continue;
+        std::swap(scratch.match.dfa, scratch.dfas[id]);
+        bool found = query_pattern(pattern, input, scratch.match, MatchMode::EXISTS).found;
+        std::swap(scratch.match.dfa, scratch.dfas[id]);
+        if (found) ids.push_back(id);
+    }
+}
@@ -0,0 +1,22 @@
+#include "search.hpp"
+#include "backref.hpp"
+#include "simd.hpp"
+
+bool search_pattern(const CompiledPattern& pattern, std::string_view buffer, SearchMode mode, std::vector<SearchMatch>& matches) {
+    if (!pattern.searchable) return false;
+    const auto& lengths = cold(pattern.tree, root(pattern.tree)).lengths;
+    if (buffer.size() < lengths.min) return false;
+    for (const auto& literal : pattern.literals) {
+        if (find_bytes(buffer, literal.text) == std::string_view::npos) return false;
+    }
+    std::vector<NfaMatch> found;
+    find_matches(pattern.captures, buffer, 0, false, mode == SearchMode::ALL, lengths.max, found);
+    for (const auto& nfa_match : found) {
+        auto& match = matches.emplace_back();
+        match.span = {nfa_match.start, nfa_match.end};
+        for (size_t slot = 0, imax = nfa_match.starts.size(); slot < imax; slot++) {
+            match.groups.push_back({nfa_match.starts[slot], nfa_match.ends[slot]});
+        }
+    }
+    return !found.empty();
+}
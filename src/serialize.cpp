@@ -0,0 +1,424 @@
+#include "serialize.hpp"
+#include "nfa.hpp"
+#include "parse.hpp"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+constexpr char pattern_magic[8] = {'C', 'R', 'N', 'K', 'P', 'A', 'T', '\0'};
+constexpr uint32_t byte_order_mark = 0x01020304;
+// magic, version, byte order, record size
+constexpr size_t header_size = sizeof(pattern_magic) + 2 * sizeof(uint32_t) + sizeof(uint64_t);
+
+struct Writer {
+    std::string& out;
+
+    template <typename T>
+    void put(T value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    void put_size(size_t value) { put<uint64_t>(value); }
+    void put_bytes(std::string_view bytes) {
+        put_size(bytes.size());
+        out.append(bytes);
+    }
+};
+
+// Every get leaves ok false instead of reading past the end
+struct Reader {
+    std::string_view data;
+    size_t pos = 0;
+    bool ok = true;
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (!ok || data.size() - pos < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+    size_t get_size() { return get<uint64_t>(); }
+    std::string_view get_bytes() {
+        size_t size = get_size();
+        if (!ok || data.size() - pos < size) {
+            ok = false;
+            return {};
+        }
+        auto bytes = data.substr(pos, size);
+        pos += size;
+        return bytes;
+    }
+    // A count of items each at least min_bytes long, rejected when the data cannot hold them
+    size_t get_count(size_t min_bytes) {
+        size_t count = get_size();
+        if (ok && count > (data.size() - pos) / min_bytes) ok = false;
+        return ok ? count : 0;
+    }
+    template <typename E>
+    E get_enum(E last) {
+        auto value = get<uint8_t>();
+        if (value > static_cast<uint8_t>(last)) ok = false;
+        return static_cast<E>(value);
+    }
+};
+
+void put_view(Writer& w, std::string_view view, std::string_view text) {
+    w.put<uint32_t>(view.empty() ? 0 : static_cast<uint32_t>(view.data() - text.data()));
+    w.put<uint32_t>(static_cast<uint32_t>(view.size()));
+}
+
+std::string_view get_view(Reader& r, std::string_view text) {
+    size_t offset = r.get<uint32_t>();
+    size_t size = r.get<uint32_t>();
+    if (offset > text.size() || size > text.size() - offset) r.ok = false;
+    return r.ok ? text.substr(offset, size) : std::string_view{};
+}
+
+// Four words, byte 64 * k + j at bit j of word k
+void put_class(Writer& w, const CharClass& cls) {
+    for (size_t k = 0; k < 4; k++) w.put<uint64_t>(class_word(cls, k));
+}
+
+CharClass get_class(Reader& r) {
+    CharClass cls;
+    for (size_t k = 0; k < 4; k++) cls |= CharClass{r.get<uint64_t>()} << (64 * k);
+    return cls;
+}
+
+void put_var(Writer& w, const Var& var) {
+    w.put<uint8_t>(static_cast<uint8_t>(var.type));
+    w.put_size(var.id);
+    w.put_size(var.n);
+    w.put_size(var.m);
+}
+
+Var get_var(Reader& r) {
+    Var var;
+    var.type = r.get_enum(VarType::B);
+    var.id = r.get_size();
+    var.n = r.get_size();
+    var.m = r.get_size();
+    return var;
+}
+
+void put_cold(Writer& w, const ExprCold& cold) {
+    w.put<uint32_t>(cold.first_term);
+    w.put<uint32_t>(cold.term_count);
+    put_var(w, cold.xvar);
+    put_var(w, cold.bvar);
+    w.put_size(cold.lengths.min);
+    w.put_size(cold.lengths.max);
+    w.put_size(cold.lengths.period);
+}
+
+void get_cold(Reader& r, ExprCold& cold) {
+    cold.first_term = r.get<uint32_t>();
+    cold.term_count = r.get<uint32_t>();
+    cold.xvar = get_var(r);
+    cold.bvar = get_var(r);
+    cold.lengths.min = r.get_size();
+    cold.lengths.max = r.get_size();
+    cold.lengths.period = r.get_size();
+}
+
+void put_terms(Writer& w, const ExprTree& tree) {
+    w.put_size(tree.terms.size());
+    for (const auto& term : tree.terms) {
+        w.put_size(term.coeff);
+        w.put<uint32_t>(term.first_var);
+        w.put<uint32_t>(term.var_count);
+    }
+    w.put_size(tree.term_vars.size());
+    for (const auto& var : tree.term_vars) put_var(w, var);
+}
+
+void get_terms(Reader& r, ExprTree& tree) {
+    tree.terms.resize(r.get_count(sizeof(uint64_t) + 2 * sizeof(uint32_t)));
+    for (auto& term : tree.terms) {
+        term.coeff = r.get_size();
+        term.first_var = r.get<uint32_t>();
+        term.var_count = r.get<uint32_t>();
+    }
+    tree.term_vars.resize(r.get_count(1 + 3 * sizeof(uint64_t)));
+    for (auto& var : tree.term_vars) var = get_var(r);
+}
+
+// Every node's terms and every term's variables lie inside the pools
+bool valid_terms(const ExprTree& tree) {
+    for (const auto& cold : tree.cold) {
+        if (cold.first_term > tree.terms.size() || cold.term_count > tree.terms.size() - cold.first_term) return false;
+    }
+    for (const auto& term : tree.terms) {
+        if (term.first_var > tree.term_vars.size() || term.var_count > tree.term_vars.size() - term.first_var) return false;
+    }
+    return true;
+}
+
+void put_nfa(Writer& w, const Nfa& nfa) {
+    w.put_size(nfa.states.size());
+    for (const auto& st : nfa.states) {
+        w.put<uint8_t>(static_cast<uint8_t>(st.op));
+        w.put<uint32_t>(st.cls);
+        w.put<uint32_t>(st.out);
+        w.put<uint32_t>(st.out1);
+    }
+    w.put_size(nfa.classes.size());
+    for (const auto& cls : nfa.classes) put_class(w, cls);
+    w.put<uint32_t>(nfa.start);
+    w.put(nfa.byte_class);
+    w.put_bytes({reinterpret_cast<const char*>(nfa.rep.data()), nfa.rep.size()});
+    w.put_size(nfa.slot_node.size());
+    for (auto node : nfa.slot_node) w.put<uint32_t>(node);
+    w.put_size(nfa.count_node.size());
+    for (auto node : nfa.count_node) w.put<uint32_t>(node);
+    put_class(w, nfa.first);
+    w.put<uint8_t>(nfa.starts_anywhere);
+}
+
+// Every edge, class, slot and byte class id must point inside the automaton. Patterns
+// an engine does not take leave its automaton empty
+bool valid_nfa(const Nfa& nfa, size_t nodes) {
+    size_t states = nfa.states.size();
+    if (states == 0) return true;
+    auto valid_out = [&](uint32_t out) { return out == no_node || out < states; };
+    for (const auto& st : nfa.states) {
+        if (!valid_out(st.out) || !valid_out(st.out1)) return false;
+        if (st.op == NfaOp::CLASS && st.cls >= nfa.classes.size()) return false;
+        if ((st.op == NfaOp::OPEN || st.op == NfaOp::CLOSE || st.op == NfaOp::REF) && st.cls >= nfa.slot_node.size()) return false;
+        if ((st.op == NfaOp::RESET || st.op == NfaOp::COUNT || st.op == NfaOp::REPEAT) && st.cls >= nfa.count_node.size()) return false;
+    }
+    for (auto node : nfa.slot_node) {
+        if (node >= nodes) return false;
+    }
+    for (auto node : nfa.count_node) {
+        if (node >= nodes) return false;
+    }
+    for (auto id : nfa.byte_class) {
+        if (id >= nfa.rep.size()) return false;
+    }
+    return nfa.start < states;
+}
+
+void get_nfa(Reader& r, Nfa& nfa, size_t nodes) {
+    nfa.states.resize(r.get_count(1 + 3 * sizeof(uint32_t)));
+    for (auto& st : nfa.states) {
+        st.op = r.get_enum(NfaOp::REPEAT);
+        st.cls = r.get<uint32_t>();
+        st.out = r.get<uint32_t>();
+        st.out1 = r.get<uint32_t>();
+    }
+    nfa.classes.resize(r.get_count(4 * sizeof(uint64_t)));
+    for (auto& cls : nfa.classes) cls = get_class(r);
+    nfa.start = r.get<uint32_t>();
+    nfa.byte_class = r.get<std::array<uint8_t, 256>>();
+    auto rep = r.get_bytes();
+    nfa.rep.assign(rep.begin(), rep.end());
+    nfa.slot_node.resize(r.get_count(sizeof(uint32_t)));
+    for (auto& node : nfa.slot_node) node = r.get<uint32_t>();
+    nfa.count_node.resize(r.get_count(sizeof(uint32_t)));
+    for (auto& node : nfa.count_node) node = r.get<uint32_t>();
+    nfa.first = get_class(r);
+    nfa.starts_anywhere = r.get<uint8_t>();
+    if (r.ok && !valid_nfa(nfa, nodes)) r.ok = false;
+    nfa.id = next_nfa_id();
+}
+
+void put_literals(Writer& w, const std::vector<RequiredLiteral>& literals) {
+    w.put_size(literals.size());
+    for (const auto& literal : literals) {
+        w.put_bytes(literal.text);
+        w.put_size(literal.leaves.size());
+        for (auto leaf : literal.leaves) w.put<uint32_t>(leaf);
+    }
+}
+
+void get_literals(Reader& r, std::vector<RequiredLiteral>& literals, size_t nodes) {
+    literals.resize(r.get_count(2 * sizeof(uint64_t)));
+    for (auto& literal : literals) {
+        literal.text = r.get_bytes();
+        literal.leaves.resize(r.get_count(sizeof(uint32_t)));
+        for (auto& leaf : literal.leaves) {
+            leaf = r.get<uint32_t>();
+            if (leaf >= nodes) r.ok = false;
+        }
+    }
+}
+
+// Only the follow tables the positions use are stored
+void put_glushkov(Writer& w, const Glushkov& glushkov) {
+    w.put_size(glushkov.positions);
+    w.put(glushkov.byte_mask);
+    for (size_t k = 0; k * 8 <= glushkov.positions; k++) w.put(glushkov.follow[k]);
+    w.put(glushkov.accept);
+}
+
+// No table may set a bit past the last position
+bool valid_glushkov(const Glushkov& glushkov) {
+    uint64_t bits = glushkov.accept;
+    for (auto mask : glushkov.byte_mask) bits |= mask;
+    for (size_t k = 0; k * 8 <= glushkov.positions; k++) {
+        for (auto mask : glushkov.follow[k]) bits |= mask;
+    }
+    return (bits >> glushkov.positions) <= 1;
+}
+
+std::unique_ptr<const Glushkov> get_glushkov(Reader& r) {
+    auto glushkov = std::make_unique<Glushkov>();
+    glushkov->positions = r.get_size();
+    if (glushkov->positions > max_glushkov_positions) r.ok = false;
+    glushkov->byte_mask = r.get<std::array<uint64_t, 256>>();
+    for (size_t k = 0; r.ok && k * 8 <= glushkov->positions; k++) glushkov->follow[k] = r.get<std::array<uint64_t, 256>>();
+    glushkov->accept = r.get<uint64_t>();
+    if (r.ok && !valid_glushkov(*glushkov)) r.ok = false;
+    return glushkov;
+}
+
+void write_pattern(const CompiledPattern& pattern, std::string& out) {
+    size_t start = out.size();
+    Writer w{out};
+    out.append(pattern_magic, sizeof(pattern_magic));
+    w.put<uint32_t>(pattern_format_version);
+    w.put<uint32_t>(byte_order_mark);
+    // Record size, patched once known
+    w.put_size(0);
+    std::string_view text = pattern.text;
+    w.put_bytes(text);
+    const auto& tree = pattern.tree;
+    w.put_size(tree.nodes.size());
+    for (const auto& expr : tree.nodes) {
+        w.put<uint8_t>(static_cast<uint8_t>(expr.group_type));
+        w.put<uint8_t>(static_cast<uint8_t>(expr.op_type));
+        w.put<uint8_t>(static_cast<uint8_t>(expr.link_type));
+        put_view(w, expr.group, text);
+        put_view(w, expr.op, text);
+        put_view(w, expr.link, text);
+        for (uint32_t field : {expr.ref_id, expr.idx, expr.depth, expr.self, expr.parent, expr.first_child, expr.child_count, expr.first_atom, expr.atom_count}) {
+            w.put<uint32_t>(field);
+        }
+        w.put_size(expr.n);
+        w.put_size(expr.m);
+        put_class(w, expr.cls);
+    }
+    w.put_size(tree.atoms.size());
+    for (const auto& cls : tree.atoms) put_class(w, cls);
+    for (const auto& cold : tree.cold) put_cold(w, cold);
+    put_terms(w, tree);
+    for (bool flag : {pattern.regular, pattern.bit_parallel, pattern.backrefs, pattern.searchable, pattern.countable}) w.put<uint8_t>(flag);
+    put_nfa(w, pattern.nfa);
+    put_nfa(w, pattern.captures);
+    put_nfa(w, pattern.counts);
+    if (pattern.glushkov) put_glushkov(w, *pattern.glushkov);
+    put_literals(w, pattern.literals);
+    uint64_t size = out.size() - start;
+    std::memcpy(out.data() + start + sizeof(pattern_magic) + 2 * sizeof(uint32_t), &size, sizeof(size));
+}
+
+bool is_pattern_data(std::string_view data) {
+    return data.size() >= header_size && std::memcmp(data.data(), pattern_magic, sizeof(pattern_magic)) == 0;
+}
+
+// Fixed part of a node record
+constexpr size_t node_record_size = 3 + 6 * sizeof(uint32_t) + 9 * sizeof(uint32_t) + 2 * sizeof(uint64_t) + 4 * sizeof(uint64_t);
+
+// Children sit after their parent in the arena and point back at it, so the links
+// form a tree and every walk over it ends
+bool valid_links(const ExprTree& tree) {
+    size_t count = tree.nodes.size();
+    for (size_t i = 0; i < count; i++) {
+        const auto& expr = tree.nodes[i];
+        if (expr.self != i || (expr.parent == no_node) != (i == 0)) return false;
+        if (expr.first_atom > tree.atoms.size() || expr.atom_count > tree.atoms.size() - expr.first_atom) return false;
+        if (expr.child_count == 0) continue;
+        if (expr.first_child <= i || expr.first_child >= count || expr.child_count > count - expr.first_child) return false;
+        for (const auto& ch : children(expr)) {
+            if (ch.parent != i) return false;
+        }
+    }
+    return count > 0;
+}
+
+// The flags pick the engine and the lengths reject inputs before it runs, so both must
+// be what compile_pattern derives from the tree, and every REF must name a group
+bool valid_derived(const CompiledPattern& pattern) {
+    const auto& tree = pattern.tree;
+    bool has_ref = false;
+    for (const auto& expr : tree.nodes) {
+        if (!is_ref(expr)) continue;
+        has_ref = true;
+        size_t n = ref_number(expr);
+        if (n == 0 || n > pattern.groups.size()) return false;
+    }
+    if (pattern.regular != is_regular(tree) || pattern.backrefs != has_ref) return false;
+    return std::all_of(tree.cold.begin(), tree.cold.end(), [](const ExprCold& cold) {
+        const auto& lengths = cold.lengths;
+        return lengths.min <= lengths.max && (lengths.period > 0 || lengths.min == lengths.max);
+    });
+}
+
+std::unique_ptr<const CompiledPattern> read_pattern(std::string_view data, size_t& used) {
+    if (!is_pattern_data(data)) return nullptr;
+    Reader r{data, sizeof(pattern_magic)};
+    if (r.get<uint32_t>() != pattern_format_version || r.get<uint32_t>() != byte_order_mark) return nullptr;
+    size_t size = r.get_size();
+    if (size < header_size || size > data.size()) return nullptr;
+    r.data = data.substr(0, size);
+
+    // As in compile_pattern, views are taken once text has its final address
+    auto pattern = std::make_unique<CompiledPattern>();
+    pattern->text = std::string{r.get_bytes()};
+    std::string_view text = pattern->text;
+    auto& tree = pattern->tree;
+    tree.nodes.resize(r.get_count(node_record_size));
+    for (auto& expr : tree.nodes) {
+        expr.group_type = r.get_enum(GroupType::REF);
+        expr.op_type = r.get_enum(OpType::N_M);
+        expr.link_type = r.get_enum(LinkType::ALTERNATION);
+        expr.group = get_view(r, text);
+        expr.op = get_view(r, text);
+        expr.link = get_view(r, text);
+        for (uint32_t* field : {&expr.ref_id, &expr.idx, &expr.depth, &expr.self, &expr.parent, &expr.first_child, &expr.child_count, &expr.first_atom, &expr.atom_count}) {
+            *field = r.get<uint32_t>();
+        }
+        expr.n = r.get_size();
+        expr.m = r.get_size();
+        expr.cls = get_class(r);
+    }
+    tree.atoms.resize(r.get_count(4 * sizeof(uint64_t)));
+    for (auto& cls : tree.atoms) cls = get_class(r);
+    if (!r.ok || !valid_links(tree)) return nullptr;
+    tree.cold.resize(tree.nodes.size());
+    for (auto& cold : tree.cold) get_cold(r, cold);
+    get_terms(r, tree);
+    if (!r.ok || !valid_terms(tree)) return nullptr;
+    for (bool* flag : {&pattern->regular, &pattern->bit_parallel, &pattern->backrefs, &pattern->searchable, &pattern->countable}) *flag = r.get<uint8_t>();
+    get_nfa(r, pattern->nfa, tree.nodes.size());
+    get_nfa(r, pattern->captures, tree.nodes.size());
+    get_nfa(r, pattern->counts, tree.nodes.size());
+    if (pattern->bit_parallel) pattern->glushkov = get_glushkov(r);
+    get_literals(r, pattern->literals, tree.nodes.size());
+    if (!r.ok || r.pos != size) return nullptr;
+    bool nfa_used = pattern->regular || pattern->backrefs;
+    if ((nfa_used && pattern->nfa.states.empty()) || (pattern->searchable && pattern->captures.states.empty())) return nullptr;
+    if (pattern->countable && pattern->counts.states.empty()) return nullptr;
+    if (pattern->bit_parallel && !pattern->regular) return nullptr;
+
+    // Pointers into the node array, the only part rederived
+    get_groups(root(tree), pattern->groups);
+    if (!valid_derived(*pattern)) return nullptr;
+    used = size;
+    return pattern;
+}
+
+bool read_patterns(std::string_view data, std::vector<std::shared_ptr<const CompiledPattern>>& patterns) {
+    for (size_t pos = 0, used = 0; pos < data.size(); pos += used) {
+        std::shared_ptr<const CompiledPattern> pattern = read_pattern(data.substr(pos), used);
+        if (!pattern) return false;
+        patterns.push_back(std::move(pattern));
+    }
+    return true;
+}
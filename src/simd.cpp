@@ -0,0 +1,147 @@
+#include "simd.hpp"
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+constexpr size_t npos = std::string_view::npos;
+
+#ifdef HAVE_X86_SIMD
+
+// Candidate starts are positions where both the first and the last needle byte line
+// up; only those are confirmed with memcmp
+__attribute__((target("avx2")))
+size_t find_bytes_avx2(const char* s, size_t n, std::string_view needle, size_t& i) {
+    size_t k = needle.size();
+    const __m256i first = _mm256_set1_epi8(needle.front());
+    const __m256i last = _mm256_set1_epi8(needle.back());
+    for (; i + k - 1 + 32 <= n; i += 32) {
+        __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + k - 1));
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+        while (mask) {
+            size_t bit = __builtin_ctz(mask);
+            if (k <= 2 || std::memcmp(s + i + bit + 1, needle.data() + 1, k - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return npos;
+}
+
+size_t find_bytes_sse2(const char* s, size_t n, std::string_view needle, size_t& i) {
+    size_t k = needle.size();
+    const __m128i first = _mm_set1_epi8(needle.front());
+    const __m128i last = _mm_set1_epi8(needle.back());
+    for (; i + k - 1 + 16 <= n; i += 16) {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + k - 1));
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(eq));
+        while (mask) {
+            size_t bit = __builtin_ctz(mask);
+            if (k <= 2 || std::memcmp(s + i + bit + 1, needle.data() + 1, k - 2) == 0) return i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return npos;
+}
+
+// Rows of the nibble tables: bit h of rows[l] is set when byte (h << 4) | l is wanted,
+// bytes below 128 in low and the rest in high
+__attribute__((target("avx2")))
+void load_nibble_rows(const CharClass& wanted, __m256i& low, __m256i& high) {
+    alignas(16) uint8_t rows[2][16] = {};
+    for_each_byte(wanted, [&](size_t b) { rows[b >> 7][b & 15] |= static_cast<uint8_t>(1u << ((b >> 4) & 7)); });
+    low = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(rows[0])));
+    high = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(rows[1])));
+}
+
+// Tests 32 bytes against the bytes still missing at once: the low nibble picks a row with
+// pshufb and the high nibble the bit in it. A hit drops its byte from the tables
+__attribute__((target("avx2")))
+void first_positions_avx2(const char* s, size_t n, CharClass& missing, BytePositions& first, size_t& i) {
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i seven = _mm256_set1_epi8(7);
+    const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                          1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i low, high;
+    load_nibble_rows(missing, low, high);
+    for (; i + 32 <= n && missing.any(); i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i lo = _mm256_and_si256(block, nibble);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble);
+        __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(low, lo), _mm256_shuffle_epi8(high, lo), _mm256_cmpgt_epi8(hi, seven));
+        __m256i hit = _mm256_and_si256(row, _mm256_shuffle_epi8(bits, hi));
+        uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hit, _mm256_setzero_si256())));
+        if (!mask) continue;
+        while (mask) {
+            size_t j = i + __builtin_ctz(mask);
+            auto b = static_cast<unsigned char>(s[j]);
+            if (missing[b]) {
+                first[b] = j;
+                missing.reset(b);
+            }
+            mask &= mask - 1;
+        }
+        load_nibble_rows(missing, low, high);
+    }
+}
+
+bool has_avx2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+#endif
+
+size_t find_byte(std::string_view haystack, char byte, size_t from) {
+    if (from >= haystack.size()) return npos;
+    // glibc's memchr is already vectorized
+    const void* hit = std::memchr(haystack.data() + from, byte, haystack.size() - from);
+    return hit ? static_cast<const char*>(hit) - haystack.data() : npos;
+}
+
+void first_positions(std::string_view input, const CharClass& wanted, BytePositions& first) {
+    first.fill(npos);
+    size_t count = wanted.count();
+    if (count == 0) return;
+    // A few distinct bytes: one vectorized memchr each, stopping at the first hit
+    constexpr size_t memchr_bytes = 8;
+    if (count <= memchr_bytes) {
+        for_each_byte(wanted, [&](size_t b) { first[b] = find_byte(input, static_cast<char>(b)); });
+        return;
+    }
+    // Otherwise one pass for all of them, stopping once none is missing
+    CharClass missing = wanted;
+    size_t i = 0;
+#ifdef HAVE_X86_SIMD
+    if (has_avx2()) first_positions_avx2(input.data(), input.size(), missing, first, i);
+#endif
+    for (size_t n = input.size(); i < n && missing.any(); i++) {
+        auto b = static_cast<unsigned char>(input[i]);
+        if (!missing[b]) continue;
+        first[b] = i;
+        missing.reset(b);
+    }
+}
+
+size_t find_bytes(std::string_view haystack, std::string_view needle, size_t from) {
+    if (needle.size() <= 1) {
+        if (needle.empty()) return (from <= haystack.size()) ? from : npos;
+        return find_byte(haystack, needle.front(), from);
+    }
+    size_t n = haystack.size();
+    if (from > n || needle.size() > n - from) return npos;
+    size_t i = from;
+#ifdef HAVE_X86_SIMD
+    size_t hit = has_avx2() ? find_bytes_avx2(haystack.data(), n, needle, i) : find_bytes_sse2(haystack.data(), n, needle, i);
+    if (hit != npos) return hit;
+#endif
+    // Tail shorter than one vector block
+    return haystack.find(needle, i);
+}
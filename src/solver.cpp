@@ -0,0 +1,136 @@
+#include "solver.hpp"
+#include "frags.hpp"
+#include <algorithm>
+#include <charconv>
+#include <functional>
+
+size_t add_solver_var(SolverSystem& sys, const Var& var) {
+    for (size_t i = 0, imax = sys.vars.size(); i < imax; i++) {
+        if (sys.vars[i].type == var.type && sys.vars[i].id == var.id) return i;
+    }
+    sys.vars.push_back(var);
+    return sys.vars.size() - 1;
+}
+
+SolverSystem compile_system(const std::vector<Constraint>& system) {
+    SolverSystem sys;
+    for (const auto& con : system) {
+        SolverConstraint compiled{{}, con.rel, con.rhs};
+        for (const auto& term : con.lhs) {
+            SolverTerm t{term.coeff, {}};
+            for (const auto& var : term.vars) {
+                t.vars.push_back(add_solver_var(sys, var));
+            }
+            compiled.terms.push_back(std::move(t));
+        }
+        sys.constraints.push_back(std::move(compiled));
+    }
+    return sys;
+}
+
+SolverSystem parse_system(const std::string& equation) {
+    std::vector<Constraint> system;
+    std::string_view rest = equation;
+    while (!rest.empty()) {
+        size_t end = rest.find(';');
+        auto text = rest.substr(0, end);
+        if (!text.empty()) system.push_back(parse_constraint(text));
+        rest.remove_prefix((end == std::string_view::npos) ? rest.size() : end + 1);
+    }
+    return compile_system(system);
+}
+
+SolverSystem build_system(const ExprTree& tree, size_t input_size) {
+    return compile_system(gen_system(tree, input_size));
+}
+
+struct TermBounds {
+    size_t lo;
+    size_t hi;
+};
+
+TermBounds term_bounds(const SolverTerm& term, const std::vector<size_t>& lo, const std::vector<size_t>& hi) {
+    TermBounds b{term.coeff, term.coeff};
+    for (auto v : term.vars) {
+        b.lo = sat_mul(b.lo, lo[v]);
+        b.hi = sat_mul(b.hi, hi[v]);
+    }
+    return b;
+}
+
+bool feasible(const SolverConstraint& con, const std::vector<size_t>& lo, const std::vector<size_t>& hi) {
+    size_t sum_lo = 0;
+    size_t sum_hi = 0;
+    for (const auto& term : con.terms) {
+        auto b = term_bounds(term, lo, hi);
+        sum_lo = sat_add(sum_lo, b.lo);
+        sum_hi = sat_add(sum_hi, b.hi);
+    }
+    if (sum_lo > con.rhs) return false;
+    return con.rel == RelType::LE || sum_hi >= con.rhs;
+}
+
+// A variable is irrelevant once every term it appears in is pinned to zero by another factor
+bool is_irrelevant(const SolverSystem& sys, size_t var, const std::vector<size_t>& hi) {
+    for (const auto& con : sys.constraints) {
+        for (const auto& term : con.terms) {
+            if (std::find(term.vars.begin(), term.vars.end(), var) == term.vars.end()) continue;
+            bool zeroed = std::any_of(term.vars.begin(), term.vars.end(), [&](size_t v) {
+                return v != var && hi[v] == 0;
+            });
+            if (!zeroed) return false;
+        }
+    }
+    return true;
+}
+
+std::vector<std::unordered_map<std::string, size_t>> solve_system(const SolverSystem& sys, size_t limit) {
+    std::vector<std::unordered_map<std::string, size_t>> solutions;
+    size_t nvars = sys.vars.size();
+    size_t cap = 0;
+    for (const auto& con : sys.constraints) cap = std::max(cap, con.rhs);
+
+    std::vector<size_t> lo(nvars);
+    std::vector<size_t> hi(nvars);
+    std::vector<size_t> order(nvars);
+    for (size_t i = 0; i < nvars; i++) {
+        lo[i] = sys.vars[i].n;
+        hi[i] = std::min(sys.vars[i].m, std::max(cap, lo[i]));
+        order[i] = i;
+    }
+    // Branch on bvars first, they switch whole terms on and off
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return is_bvar(sys.vars[a]) > is_bvar(sys.vars[b]);
+    });
+
+    std::function<void(size_t)> search = [&](size_t depth) {
+        if (solutions.size() >= limit) return;
+        for (const auto& con : sys.constraints) {
+            if (!feasible(con, lo, hi)) return;
+        }
+        if (depth == nvars) {
+            std::unordered_map<std::string, size_t> sol;
+            for (size_t i = 0; i < nvars; i++) sol[var_name(sys.vars[i])] = lo[i];
+            solutions.push_back(std::move(sol));
+            return;
+        }
+        size_t v = order[depth];
+        size_t vlo = lo[v];
+        size_t vhi = hi[v];
+        if (is_irrelevant(sys, v, hi)) {
+            hi[v] = vlo;
+            search(depth + 1);
+            hi[v] = vhi;
+            return;
+        }
+        for (size_t val = vlo; val <= vhi && solutions.size() < limit; val++) {
+            lo[v] = val;
+            hi[v] = val;
+            search(depth + 1);
+        }
+        lo[v] = vlo;
+        hi[v] = vhi;
+    };
+    search(0);
+    return solutions;
+}
@@ -0,0 +1,107 @@
+#include "stream.hpp"
+#include <iterator>
+
+bool open_stream(const CompiledPattern& pattern, StreamMatcher& stream) {
+    stream = {};
+    if (!pattern.regular) return false;
+    stream.nfa = &pattern.nfa;
+    stream.max_length = cold(pattern.tree, root(pattern.tree)).lengths.max;
+    stream.seen.assign(pattern.nfa.states.size(), 0);
+    stream.claimed.assign(pattern.nfa.states.size(), 0);
+    stream.levels.emplace_back();
+    return true;
+}
+
+bool take_best(StreamMatcher& stream, StreamLevel& level, size_t start) {
+    auto& best = level.best;
+    if (level.found && (start > best.start || (start == best.start && stream.pos <= best.end))) return false;
+    best = {start, stream.pos};
+    level.found = true;
+    return true;
+}
+
+// Runs the level's threads at pos over byte c, or over the end of the stream when c < 0,
+// and tells whether its match changed. Threads stay ordered by start, so the first to
+// reach a state is the leftmost. A thread stepping to a state an earlier level already
+// stepped to is dropped: it could only match where that level's match grows, which
+// drops this level too
+bool advance_level(StreamMatcher& stream, StreamLevel& level, int c) {
+    const auto& nfa = *stream.nfa;
+    if (!level.found && stream.pos >= level.from) level.threads.push_back({nfa.start, stream.pos});
+    bool changed = false;
+    stream.generation++;
+    stream.next.clear();
+    for (const auto& thread : level.threads) {
+        stream.stack.push_back(thread);
+        while (!stream.stack.empty()) {
+            auto t = stream.stack.back();
+            stream.stack.pop_back();
+            if (t.state == no_node || stream.seen[t.state] == stream.generation) continue;
+            if (level.found && t.start > level.best.start) continue;
+            if (stream.pos - t.start > stream.max_length) continue;
+            stream.seen[t.state] = stream.generation;
+            const auto& st = nfa.states[t.state];
+            switch (st.op) {
+                case NfaOp::CLASS:
+                    if (c < 0 || !nfa.classes[st.cls][c] || stream.claimed[st.out] == stream.pos + 1) break;
+                    stream.claimed[st.out] = stream.pos + 1;
+                    stream.next.push_back({st.out, t.start});
+                    break;
+                case NfaOp::SPLIT:
+                    stream.stack.push_back({st.out1, t.start});
+                    stream.stack.push_back({st.out, t.start});
+                    break;
+                case NfaOp::EPSILON: case NfaOp::OPEN: case NfaOp::CLOSE: case NfaOp::RESET: case NfaOp::COUNT: case NfaOp::REPEAT:
+                    stream.stack.push_back({st.out, t.start});
+                    break;
+                case NfaOp::MATCH:
+                    changed = take_best(stream, level, t.start) || changed;
+                    break;
+                case NfaOp::REF:
+                    break;
+            }
+        }
+    }
+    std::swap(level.threads, stream.next);
+    return changed;
+}
+
+void scan_stream(StreamMatcher& stream, int c, std::vector<Span>& matches) {
+    auto& levels = stream.levels;
+    for (auto it = levels.begin(); it != levels.end(); ++it) {
+        auto& level = *it;
+        if (!advance_level(stream, level, c)) continue;
+        // A new match drops the searches behind the old one; an empty match is stepped
+        // over, as in search_pattern
+        levels.erase(std::next(it), levels.end());
+        level.followers.clear();
+        levels.emplace_back().from = (level.best.end > level.best.start) ? level.best.end : level.best.end + 1;
+    }
+    // A level with nothing left to run is final once the ones before it are
+    for (auto it = std::next(levels.begin()); it != levels.end();) {
+        if (!it->found || !it->threads.empty()) {
+            ++it;
+            continue;
+        }
+        auto& followers = std::prev(it)->followers;
+        followers.push_back(it->best);
+        followers.insert(followers.end(), it->followers.begin(), it->followers.end());
+        it = levels.erase(it);
+    }
+    while (levels.front().found && levels.front().threads.empty()) {
+        auto& done = levels.front();
+        matches.push_back(done.best);
+        matches.insert(matches.end(), done.followers.begin(), done.followers.end());
+        levels.pop_front();
+    }
+    if (c >= 0) stream.pos++;
+}
+
+void feed_stream(StreamMatcher& stream, std::string_view chunk, std::vector<Span>& matches) {
+    for (unsigned char c : chunk) scan_stream(stream, c, matches);
+}
+
+void close_stream(StreamMatcher& stream, std::vector<Span>& matches) {
+    scan_stream(stream, -1, matches);
+    stream.levels.clear();
+}
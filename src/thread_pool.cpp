@@ -0,0 +1,115 @@
+#include "thread_pool.hpp"
+
+namespace {
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_index = 0;
+}
+
+ThreadPool::ThreadPool(size_t threads) {
+    threads = (threads > 0) ? (threads) : (1);
+    for (size_t i = 0; i < threads; i++) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        stopping = true;
+    }
+    idle_cv.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+size_t ThreadPool::size() const {
+    return workers.size();
+}
+
+// Workers are 0..size()-1, any outside thread shares the extra slot size()
+size_t ThreadPool::worker_index() const {
+    return (current_pool == this) ? (current_index) : (workers.size());
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t index = worker_index();
+    if (index == workers.size()) index = next_queue++ % workers.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    queued++;
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+    }
+    idle_cv.notify_one();
+}
+
+void ThreadPool::submit(TaskGroup& group, std::function<void()> task) {
+    group.pending++;
+    submit([&group, task = std::move(task)] {
+        task();
+        group.pending--;
+    });
+}
+
+bool ThreadPool::pop_task(size_t index, std::function<void()>& task) {
+    size_t count = queues.size();
+    if (index < workers.size()) {
+        auto& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    for (size_t k = 1; k <= count; k++) {
+        auto& victim = *queues[(index + k) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::run_one() {
+    std::function<void()> task;
+    if (!pop_task(worker_index(), task)) return false;
+    task();
+    return true;
+}
+
+void ThreadPool::wait(TaskGroup& group) {
+    while (group.pending > 0) {
+        if (!run_one()) std::this_thread::yield();
+    }
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    current_pool = this;
+    current_index = index;
+    std::function<void()> task;
+    while (true) {
+        if (pop_task(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        idle_cv.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) return;
+    }
+}
+
+size_t default_thread_count() {
+    size_t count = std::thread::hardware_concurrency();
+    return (count > 0) ? (count) : (1);
+}
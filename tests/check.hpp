@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Minimal harness behind make test. TEST(name) registers a function run by
+// tests/main.cpp; CHECK records a failure with its location and carries on
+struct TestCase {
+    std::string_view name;
+    void (*run)();
+};
+
+std::vector<TestCase>& test_cases();
+bool add_test(std::string_view name, void (*run)());
+void fail_check(std::string_view what, const char* file, int line);
+
+#define TEST(name)                                          \
+    void name();                                            \
+    static const bool name##_added = add_test(#name, name); \
+    void name()
+
+#define CHECK(cond)                                       \
+    do {                                                  \
+        if (!(cond)) fail_check(#cond, __FILE__, __LINE__); \
+    } while (0)
+
+// Same, naming the regex and input that failed
+#define CHECK_ON(cond, regex, input)                                                             \
+    do {                                                                                         \
+        if (!(cond)) fail_check(std::string(#cond) + " on /" + std::string(regex) + "/ \"" + std::string(input) + "\"", __FILE__, __LINE__); \
+    } while (0)
+
+// Random regexes over a and b: literals, classes, capture groups, alternations and every
+// repetition form, nested at most depth deep. With refs, \1 and \2 may follow groups
+std::string random_regex(std::mt19937& rng, size_t depth = 2, bool refs = false);
+// Every string over alphabet of at most max_length bytes
+std::vector<std::string> all_inputs(std::string_view alphabet, size_t max_length);
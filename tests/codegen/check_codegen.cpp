@@ -0,0 +1,46 @@
+#include "pattern.hpp"
+#include "codegen_matchers.hpp"
+
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// check_codegen REGEX...: the matchers regex_codegen wrote for the same regexes, as m0,
+// m1, ..., must answer every short input as query_pattern does. Run by make test
+int main(int argc, char** argv) {
+    bool (*const matchers[])(std::string_view) = {m0, m1, m2, m3, m4, m5};
+    if (argc - 1 != static_cast<int>(std::size(matchers))) {
+        std::cerr << "Expected " << std::size(matchers) << " regexes\n";
+        return 1;
+    }
+
+    // Every string of up to four bytes over an alphabet touching each pattern's classes
+    std::string_view alphabet = "abc.@z9";
+    std::vector<std::string> inputs{""};
+    for (size_t begin = 0, length = 0; length < 4; length++) {
+        size_t end = inputs.size();
+        for (size_t i = begin; i < end; i++) {
+            for (char c : alphabet) inputs.push_back(inputs[i] + c);
+        }
+        begin = end;
+    }
+    inputs.insert(inputs.end(), {"ab.cd@zz.com", "x@y.zz", "a@b.c", "aaaaaaaaaaaaaaaaaaaabc"});
+
+    size_t failures = 0;
+    for (size_t k = 0; k < std::size(matchers); k++) {
+        auto pattern = compile_pattern(argv[k + 1]);
+        if (!pattern) {
+            std::cerr << "Parse failed: " << argv[k + 1] << "\n";
+            return 1;
+        }
+        MatchScratch scratch;
+        for (const auto& input : inputs) {
+            bool expected = query_pattern(*pattern, input, scratch, MatchMode::EXISTS).found;
+            if (matchers[k](input) == expected) continue;
+            if (++failures <= 20) std::cerr << "m" << k << " /" << argv[k + 1] << "/ \"" << input << "\": generated " << !expected << ", expected " << expected << "\n";
+        }
+    }
+    std::cout << std::size(matchers) << " generated matchers, " << failures << " mismatches\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include "check.hpp"
+
+#include <iostream>
+
+namespace {
+
+size_t failures = 0;
+
+const char* regex_atoms[] = {"a", "b", "ab", "ba", "[ab]", "[^b]", "[[:alpha:]]", "\\w"};
+const char* regex_ops[] = {"", "", "", "*", "+", "?", "{2}", "{1,3}", "{2,}", "{,2}"};
+
+}
+
+std::vector<TestCase>& test_cases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+bool add_test(std::string_view name, void (*run)()) {
+    test_cases().push_back({name, run});
+    return true;
+}
+
+void fail_check(std::string_view what, const char* file, int line) {
+    if (++failures <= 20) std::cerr << file << ":" << line << ": CHECK failed: " << what << "\n";
+}
+
+std::string random_regex(std::mt19937& rng, size_t depth, bool refs) {
+    auto pick = [&](size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(rng); };
+    size_t groups = 0;
+    auto alternation = [&](auto& self, size_t d) -> std::string {
+        std::string result;
+        size_t branches = pick(5) < 3 ? 1 : 2 + pick(2);
+        for (size_t b = 0; b < branches; b++) {
+            if (b > 0) result += '|';
+            size_t parts = 1 + pick(3);
+            for (size_t p = 0; p < parts; p++) {
+                size_t kind = pick(20);
+                if (d >= depth || kind < 9) {
+                    result += regex_atoms[pick(std::size(regex_atoms))];
+                } else if (refs && kind < 11 && groups > 0) {
+                    result += "\\" + std::to_string(1 + pick(groups));
+                    continue;
+                } else {
+                    groups++;
+                    result += "(" + self(self, d + 1) + ")";
+                }
+                result += regex_ops[pick(std::size(regex_ops))];
+            }
+        }
+        return result;
+    };
+    return alternation(alternation, 0);
+}
+
+std::vector<std::string> all_inputs(std::string_view alphabet, size_t max_length) {
+    std::vector<std::string> inputs{""};
+    for (size_t begin = 0, length = 0; length < max_length; length++) {
+        size_t end = inputs.size();
+        for (size_t i = begin; i < end; i++) {
+            for (char c : alphabet) inputs.push_back(inputs[i] + c);
+        }
+        begin = end;
+    }
+    return inputs;
+}
+
+// run_tests [NAME...]: runs the tests whose names contain any NAME, or all of them
+int main(int argc, char** argv) {
+    size_t ran = 0;
+    for (const auto& test : test_cases()) {
+        bool wanted = argc < 2;
+        for (int i = 1; i < argc; i++) wanted |= test.name.find(argv[i]) != std::string_view::npos;
+        if (!wanted) continue;
+        size_t before = failures;
+        test.run();
+        ran++;
+        std::cout << (failures == before ? "ok   " : "FAIL ") << test.name << "\n";
+    }
+    std::cout << ran << " tests, " << failures << " failed checks\n";
+    return failures == 0 ? 0 : 1;
+}
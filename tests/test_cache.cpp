@@ -0,0 +1,40 @@
+#include "check.hpp"
+#include "pattern_cache.hpp"
+
+TEST(cache_hits_and_misses) {
+    PatternCache cache(1 << 20);
+    auto first = cache.get("a(b|c)*");
+    auto second = cache.get("a(b|c)*");
+    CHECK(first && first == second);
+    CHECK(cache.hits() == 1 && cache.misses() == 1 && cache.size() == 1);
+    CHECK(cache.bytes() == pattern_bytes(*first));
+    CHECK(!cache.get("(a)\\2") && !cache.get("(a)\\2"));
+    CHECK(cache.misses() == 3 && cache.size() == 1);
+}
+
+// Least recently used goes first, and a pattern evicted under a caller stays valid
+TEST(cache_eviction) {
+    const char* regexes[] = {"x1y*", "x2y*", "x3y*"};
+    size_t sizes[3];
+    for (size_t i = 0; i < 3; i++) sizes[i] = pattern_bytes(*compile_pattern(regexes[i]));
+    PatternCache cache(sizes[0] + sizes[1] + sizes[2] - 1);
+    auto held = cache.get(regexes[0]);
+    cache.get(regexes[1]);
+    cache.get(regexes[0]);
+    cache.get(regexes[2]);
+    CHECK(cache.size() == 2);
+    CHECK(cache.bytes() == sizes[0] + sizes[2]);
+    size_t misses = cache.misses();
+    cache.get(regexes[0]);
+    CHECK(cache.misses() == misses);
+    cache.get(regexes[1]);
+    CHECK(cache.misses() == misses + 1);
+    CHECK(cache.size() == 2);
+    MatchScratch scratch;
+    CHECK(query_pattern(*held, "x1yy", scratch, MatchMode::EXISTS).found);
+
+    // The newest entry is kept even when it alone is over the limit
+    PatternCache tiny(1);
+    CHECK(tiny.get(regexes[0]) && tiny.size() == 1);
+    CHECK(tiny.get(regexes[1]) && tiny.size() == 1);
+}
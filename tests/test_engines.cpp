@@ -0,0 +1,52 @@
+#include "check.hpp"
+#include "backref.hpp"
+#include "dfa.hpp"
+#include "glushkov.hpp"
+#include "pattern.hpp"
+
+// The automata behind EXISTS agree on whole-input matches: the bit-parallel one, the
+// lazy DFA, and an anchored longest match of the capture NFA reaching the end
+TEST(regular_engines_agree) {
+    std::mt19937 rng(15);
+    auto inputs = all_inputs("ab", 5);
+    for (size_t k = 0; k < 200; k++) {
+        auto regex = random_regex(rng);
+        auto pattern = compile_pattern(regex);
+        CHECK_ON(pattern && pattern->regular && pattern->searchable, regex, "");
+        if (!pattern || !pattern->regular || !pattern->searchable) continue;
+        DfaCache dfa;
+        for (const auto& input : inputs) {
+            bool expected = dfa_match(pattern->nfa, dfa, input);
+            if (pattern->bit_parallel) CHECK_ON(glushkov_match(*pattern->glushkov, input) == expected, regex, input);
+            NfaMatch match;
+            bool whole = longest_match(pattern->captures, input, 0, true, unbounded, match) && match.end == input.size();
+            CHECK_ON(whole == expected, regex, input);
+        }
+    }
+}
+
+// Back-references read the text their group matched last, not its pattern
+TEST(backref_engine) {
+    struct Case {
+        const char* regex;
+        const char* input;
+        bool expected;
+    } cases[] = {
+        {"(a|b)\\1", "aa", true},
+        {"(a|b)\\1", "ab", false},
+        {"(\\w+)\\1", "abab", true},
+        {"(\\w+)\\1", "abba", false},
+        {"(a*)b\\1", "aabaa", true},
+        {"(a*)b\\1", "aaba", false},
+        {"(a|b)+\\1", "abb", true},
+        {"(a|b)+\\1", "aba", false},
+    };
+    for (const auto& c : cases) {
+        auto pattern = compile_pattern(c.regex);
+        CHECK_ON(pattern && pattern->backrefs, c.regex, c.input);
+        if (!pattern || !pattern->backrefs) continue;
+        MatchScratch scratch;
+        reset_scratch(pattern->tree, scratch);
+        CHECK_ON(ref_match(pattern->nfa, c.input, scratch) == c.expected, c.regex, c.input);
+    }
+}
@@ -0,0 +1,119 @@
+#include "check.hpp"
+#include "frontend.hpp"
+#include <optional>
+#include <sstream>
+
+namespace {
+
+// The count vectors of one answer as "3,4" strings, or nullopt for no match. A match
+// without counts is one empty string in both front ends
+using Answer = std::optional<std::vector<std::string>>;
+
+std::vector<Answer> batch_answers(const std::string& regex, const std::vector<std::string>& inputs) {
+    std::string text;
+    for (const auto& input : inputs) text += input + "\n";
+    std::istringstream in(text);
+    std::ostringstream out;
+    LineReader reader{&in, {}, 0};
+    run_batch(regex, reader, out, MatchMode::ALL);
+
+    std::vector<Answer> answers;
+    std::istringstream lines(out.str());
+    std::string line;
+    while (std::getline(lines, line)) {
+        auto verdict = line.substr(line.find('\t') + 1);
+        if (verdict == "no match") {
+            answers.emplace_back();
+            continue;
+        }
+        std::vector<std::string> matches;
+        auto tab = verdict.find('\t');
+        std::string_view rest = (tab == std::string::npos) ? "" : std::string_view{verdict}.substr(tab + 1);
+        for (size_t pos = 0;;) {
+            size_t end = rest.find("; ", pos);
+            matches.emplace_back(rest.substr(pos, end - pos));
+            if (end == std::string_view::npos) break;
+            pos = end + 2;
+        }
+        answers.emplace_back(std::move(matches));
+    }
+    return answers;
+}
+
+Answer interactive_answer(const std::string& regex, const std::string& input) {
+    std::istringstream in(regex + "\n" + input + "\n");
+    std::ostringstream out;
+    run_interactive(in, out);
+
+    std::vector<std::string> matches;
+    std::istringstream lines(out.str());
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line == "no match") return std::nullopt;
+        if (!line.starts_with("match: ")) continue;
+        std::string counts;
+        std::istringstream fields(line.substr(7));
+        std::string field;
+        while (std::getline(fields, field, ',')) {
+            if (field.starts_with(" ")) field.erase(0, 1);
+            if (field.empty()) continue;
+            counts += (counts.empty() ? "" : ",") + field;
+        }
+        matches.push_back(counts);
+    }
+    return matches;
+}
+
+void check_front_ends(const std::string& regex, const std::vector<std::string>& inputs) {
+    auto batch = batch_answers(regex, inputs);
+    CHECK_ON(batch.size() == inputs.size(), regex, "");
+    for (size_t i = 0; i < batch.size() && i < inputs.size(); i++) {
+        CHECK_ON(interactive_answer(regex, inputs[i]) == batch[i], regex, inputs[i]);
+    }
+}
+
+}
+
+// The prompt and --batch answer every input through query_pattern alike
+TEST(frontends_agree) {
+    CHECK(interactive_answer("(a|b)*c", "ababc") == Answer(std::vector<std::string>{"4"}));
+    CHECK(interactive_answer("[0-9]+", "123") == Answer(std::vector<std::string>{"3"}));
+    CHECK(interactive_answer("[0-9]+", "12a") == std::nullopt);
+    check_front_ends("(a|b)*c", {"ababc", "c", "abab", ""});
+    check_front_ends("(a)\\1", {"aa", "ab", "a"});
+
+    std::mt19937 rng(33);
+    auto inputs = all_inputs("ab", 4);
+    for (size_t k = 0; k < 30; k++) {
+        check_front_ends(random_regex(rng, 2, k % 3 == 0), inputs);
+    }
+}
+
+// Threaded --batch prints what the sequential one does, for any thread count and for
+// stream and mapped input, over enough lines to span several chunks
+TEST(batch_threads_agree) {
+    std::mt19937 rng(9);
+    auto words = all_inputs("ab", 6);
+    std::string text;
+    for (size_t i = 0; i < 3000; i++) text += words[rng() % words.size()] + "\n";
+    text += "ab";
+
+    for (const char* regex : {"(a|b)*b", "(ab|b)+a?", "(a)b*\\1", "a{2,}b|b{,2}"}) {
+        for (auto mode : {MatchMode::EXISTS, MatchMode::FIRST, MatchMode::COUNT, MatchMode::ALL}) {
+            std::istringstream in(text);
+            std::ostringstream expected;
+            LineReader reader{&in, {}, 0};
+            run_batch(regex, reader, expected, mode);
+            for (size_t threads : {1, 2, 3, 8}) {
+                std::istringstream stream_in(text);
+                std::ostringstream streamed, mapped;
+                LineReader stream_reader{&stream_in, {}, 0};
+                LineReader mapped_reader{nullptr, text, 0};
+                run_batch_parallel(regex, stream_reader, streamed, threads, mode);
+                run_batch_parallel(regex, mapped_reader, mapped, threads, mode);
+                CHECK_ON(streamed.str() == expected.str(), regex, std::to_string(threads));
+                CHECK_ON(mapped.str() == expected.str(), regex, std::to_string(threads));
+            }
+        }
+    }
+}
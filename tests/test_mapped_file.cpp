@@ -0,0 +1,45 @@
+#include "check.hpp"
+#include "mapped_file.hpp"
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+std::vector<std::string> lines_of(std::string_view text) {
+    std::vector<std::string> lines;
+    std::string_view line;
+    for (size_t pos = 0; next_line(text, pos, line);) lines.emplace_back(line);
+    return lines;
+}
+
+std::string write_temp(const std::string& name, std::string_view contents) {
+    auto path = (std::filesystem::temp_directory_path() / name).string();
+    std::ofstream(path, std::ios::binary) << contents;
+    return path;
+}
+
+}
+
+// Split like std::getline: a '\r' before '\n' stays on its line, a last line without
+// '\n' still counts, and empty text has no lines
+TEST(next_line_splits) {
+    CHECK((lines_of("a\r\nb\r\n") == std::vector<std::string>{"a\r", "b\r"}));
+    CHECK((lines_of("a\nb") == std::vector<std::string>{"a", "b"}));
+    CHECK((lines_of("a\n\nb\n") == std::vector<std::string>{"a", "", "b"}));
+    CHECK((lines_of("\n") == std::vector<std::string>{""}));
+    CHECK(lines_of("").empty());
+}
+
+// Reopening swaps the view for the new file's, and a failed open leaves none
+TEST(mapped_file_reopen) {
+    auto first = write_temp("crank_mapped_first", "one\r\ntwo");
+    auto empty = write_temp("crank_mapped_empty", "");
+    MappedFile mapped;
+    CHECK(mapped.open(first) && mapped.view() == "one\r\ntwo");
+    CHECK(mapped.open(empty) && mapped.view().empty());
+    CHECK(lines_of(mapped.view()).empty());
+    CHECK(mapped.open(first) && (lines_of(mapped.view()) == std::vector<std::string>{"one\r", "two"}));
+    CHECK(!mapped.open(first + ".missing") && mapped.view().empty());
+    std::filesystem::remove(first);
+    std::filesystem::remove(empty);
+}
@@ -0,0 +1,85 @@
+#include "check.hpp"
+#include "pattern.hpp"
+
+// Brackets, escapes and POSIX classes are one atom wide, whatever their text length
+TEST(class_leaf_widths) {
+    struct Case {
+        const char* regex;
+        const char* input;
+        size_t width;
+    } cases[] = {
+        {"[0-9]", "7", 1},
+        {"\\d", "7", 1},
+        {"[[:alpha:]]", "q", 1},
+        {"a\\db", "a1b", 3},
+        {"[^a]x\\w", "bx_", 3},
+    };
+    for (const auto& c : cases) {
+        auto pattern = compile_pattern(c.regex);
+        const auto& lengths = cold(pattern->tree, root(pattern->tree)).lengths;
+        CHECK_ON(lengths.min == c.width && lengths.max == c.width, c.regex, c.input);
+        MatchScratch scratch;
+        for (auto mode : {MatchMode::EXISTS, MatchMode::FIRST, MatchMode::COUNT, MatchMode::ALL}) {
+            CHECK_ON(query_pattern(*pattern, c.input, scratch, mode).found, c.regex, c.input);
+        }
+    }
+    auto pattern = compile_pattern("[0-9]+");
+    MatchScratch scratch;
+    auto result = query_pattern(*pattern, "123", scratch, MatchMode::ALL);
+    CHECK(result.found && result.matches == std::vector<std::vector<size_t>>{{3}});
+    CHECK(!query_pattern(*pattern, "12a", scratch, MatchMode::COUNT).found);
+}
+
+// FIRST, COUNT and ALL find a match exactly when EXISTS does, and agree with each other
+TEST(modes_agree) {
+    std::mt19937 rng(16);
+    auto inputs = all_inputs("ab", 5);
+    for (size_t k = 0; k < 300; k++) {
+        auto regex = random_regex(rng, 2, k >= 200);
+        auto pattern = compile_pattern(regex);
+        if (!pattern) continue;
+        CHECK_ON(pattern->countable, regex, "");
+        MatchScratch scratch;
+        for (const auto& input : inputs) {
+            bool exists = query_pattern(*pattern, input, scratch, MatchMode::EXISTS).found;
+            auto first = query_pattern(*pattern, input, scratch, MatchMode::FIRST);
+            auto count = query_pattern(*pattern, input, scratch, MatchMode::COUNT);
+            auto all = query_pattern(*pattern, input, scratch, MatchMode::ALL);
+            CHECK_ON(first.found == exists && count.found == exists && all.found == exists, regex, input);
+            CHECK_ON(count.count == all.matches.size() && first.matches.size() == exists, regex, input);
+            if (!exists || all.matches.empty() || first.matches.empty()) continue;
+            CHECK_ON(first.matches.front() == all.matches.front(), regex, input);
+            CHECK_ON(all.matches.front().size() == pattern->counts.count_node.size(), regex, input);
+        }
+    }
+}
+
+// One count per repetition in x-var order, the last pass's for a nested one
+TEST(repetition_counts) {
+    struct Case {
+        const char* regex;
+        const char* input;
+        std::vector<std::vector<size_t>> expected;
+    } cases[] = {
+        {"[0-9]+", "123", {{3}}},
+        {"(a|b)*c", "ababc", {{4}}},
+        {"x(ab)*y{2}", "xababyy", {{2, 2}}},
+        {"(a+)+b*", "aab", {{2, 1, 1}, {1, 2, 1}}},
+        {"(a+|b+)c", "aac", {{2, 0}}},
+        {"a{2,}(b+c)*", "aaabcbbc", {{3, 2, 2}}},
+        {"a?a?", "a", {{1, 0}, {0, 1}}},
+        {"(\\w+)\\1", "abab", {{2}}},
+        {"(a|b)+\\1", "abb", {{2}}},
+        {"(a*)b\\1", "aabaa", {{2}}},
+        {"(a*)+b\\1", "aab", {{0, 2}, {0, 3}}},
+    };
+    for (const auto& c : cases) {
+        auto pattern = compile_pattern(c.regex);
+        MatchScratch scratch;
+        auto all = query_pattern(*pattern, c.input, scratch, MatchMode::ALL);
+        CHECK_ON(all.matches == c.expected, c.regex, c.input);
+        auto first = query_pattern(*pattern, c.input, scratch, MatchMode::FIRST);
+        CHECK_ON(first.matches.size() == 1 && first.matches.front() == c.expected.front(), c.regex, c.input);
+        CHECK_ON(query_pattern(*pattern, c.input, scratch, MatchMode::COUNT).count == c.expected.size(), c.regex, c.input);
+    }
+}
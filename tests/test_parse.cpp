@@ -0,0 +1,35 @@
+#include "check.hpp"
+#include "pattern.hpp"
+
+// Groups are numbered in the order they open, outer before inner
+TEST(group_numbering) {
+    struct Case {
+        const char* regex;
+        const char* input;
+        bool expected;
+    } cases[] = {
+        {"(a)(b(c))\\3", "abcc", true},
+        {"(a)(b(c))\\3", "abcbc", false},
+        {"(a)(b(c))\\2", "abcbc", true},
+        {"((a)b)\\2", "aba", true},
+        {"((a)b)\\1", "abab", true},
+        {"(a)|(b)\\2", "bb", true},
+    };
+    for (const auto& c : cases) {
+        auto pattern = compile_pattern(c.regex);
+        CHECK_ON(pattern && pattern->groups.size() > 0, c.regex, c.input);
+        if (!pattern) continue;
+        for (size_t k = 0; k < pattern->groups.size(); k++) {
+            CHECK_ON(pattern->groups[k]->ref_id == k + 1, c.regex, c.input);
+        }
+        MatchScratch scratch;
+        CHECK_ON(query_pattern(*pattern, c.input, scratch, MatchMode::EXISTS).found == c.expected, c.regex, c.input);
+    }
+}
+
+// A reference must name a group opened before it
+TEST(dangling_refs_rejected) {
+    for (const char* regex : {"\\1", "a\\0", "(a)\\2", "\\1(a)", "(a)(\\3)(b)", "x|\\1"}) {
+        CHECK_ON(!compile_pattern(regex), regex, "");
+    }
+}
@@ -0,0 +1,86 @@
+#include "check.hpp"
+#include "literals.hpp"
+#include "pattern_set.hpp"
+#include <algorithm>
+
+namespace {
+
+// Ids find_literals reports, sorted, checking it left reported all false
+std::vector<uint32_t> found_literals(const LiteralAutomaton& automaton, std::string_view input) {
+    std::vector<uint8_t> reported(automaton.literal.size(), false);
+    std::vector<uint32_t> found;
+    find_literals(automaton, input, reported, found);
+    CHECK_ON(std::count(reported.begin(), reported.end(), true) == 0, "", input);
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+}
+
+// Overlapping literals, literals ending inside others, and inputs holding every literal
+// early, which ends the scan before the input does
+TEST(aho_corasick_literals) {
+    LiteralAutomaton automaton;
+    build_literal_automaton({"aba", "bab", "abc", "bc", "c", "xyzzy"}, automaton);
+    CHECK((found_literals(automaton, "ababa") == std::vector<uint32_t>{0, 1}));
+    CHECK((found_literals(automaton, "xabc") == std::vector<uint32_t>{2, 3, 4}));
+    CHECK((found_literals(automaton, "bcc") == std::vector<uint32_t>{3, 4}));
+    CHECK((found_literals(automaton, "xyzzabc") == std::vector<uint32_t>{2, 3, 4}));
+    CHECK((found_literals(automaton, "ababcxyzzy") == std::vector<uint32_t>{0, 1, 2, 3, 4, 5}));
+    CHECK((found_literals(automaton, "xyzzyababcababc") == std::vector<uint32_t>{0, 1, 2, 3, 4, 5}));
+    CHECK(found_literals(automaton, "").empty());
+
+    // Random literal sets over two bytes, against a search for each literal
+    std::mt19937 rng(8);
+    auto words = all_inputs("ab", 4);
+    for (size_t k = 0; k < 50; k++) {
+        std::vector<std::string> literals;
+        for (size_t i = 1 + k % 6; literals.size() < i;) {
+            const auto& word = words[1 + rng() % (words.size() - 1)];
+            if (std::find(literals.begin(), literals.end(), word) == literals.end()) literals.push_back(word);
+        }
+        build_literal_automaton(literals, automaton);
+        for (const auto& input : all_inputs("ab", 6)) {
+            std::vector<uint32_t> expected;
+            for (uint32_t id = 0; id < literals.size(); id++) {
+                if (input.find(literals[id]) != std::string::npos) expected.push_back(id);
+            }
+            CHECK_ON(found_literals(automaton, input) == expected, literals[0], input);
+        }
+    }
+}
+
+// One scratch shared by sets of the same size must not keep the first set's buffers
+TEST(pattern_set_scratch_reuse) {
+    PatternSetScratch scratch;
+    std::vector<uint32_t> ids;
+    auto digits = compile_pattern_set({"x[0-9]+"});
+    auto longer = compile_pattern_set({"abcdefghijkl[0-9]+"});
+    CHECK(digits && longer);
+    if (!digits || !longer) return;
+    match_set(*digits, "x12", scratch, ids);
+    CHECK(ids == std::vector<uint32_t>{0});
+    match_set(*longer, "abcdefghijkl12", scratch, ids);
+    CHECK(ids == std::vector<uint32_t>{0});
+    match_set(*longer, "x12", scratch, ids);
+    CHECK(ids.empty());
+
+    // Sets of random patterns, all through one scratch, agree with the patterns alone
+    std::mt19937 rng(21);
+    auto inputs = all_inputs("ab", 4);
+    for (size_t k = 0; k < 20; k++) {
+        std::vector<std::string> regexes;
+        for (size_t i = 0; i < 3; i++) regexes.push_back(random_regex(rng, 1));
+        auto set = compile_pattern_set(regexes);
+        if (!set) continue;
+        MatchScratch match;
+        for (const auto& input : inputs) {
+            std::vector<uint32_t> expected;
+            for (uint32_t id = 0; id < regexes.size(); id++) {
+                if (query_pattern(*set->patterns[id], input, match, MatchMode::EXISTS).found) expected.push_back(id);
+            }
+            match_set(*set, input, scratch, ids);
+            CHECK_ON(ids == expected, regexes[0] + " | " + regexes[1] + " | " + regexes[2], input);
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include "check.hpp"
+#include "dfa.hpp"
+#include "search.hpp"
+#include "simd.hpp"
+
+// Non-overlapping leftmost-longest matches, found by trying every span in turn
+std::vector<Span> naive_search(const CompiledPattern& pattern, std::string_view buffer) {
+    std::vector<Span> spans;
+    DfaCache dfa;
+    for (size_t from = 0; from <= buffer.size();) {
+        Span found;
+        for (size_t start = from; start <= buffer.size() && found.start == unbounded; start++) {
+            for (size_t end = buffer.size() + 1; end-- > start;) {
+                if (!dfa_match(pattern.nfa, dfa, buffer.substr(start, end - start))) continue;
+                found = {start, end};
+                break;
+            }
+        }
+        if (found.start == unbounded) break;
+        spans.push_back(found);
+        from = (found.end > found.start) ? found.end : found.end + 1;
+    }
+    return spans;
+}
+
+TEST(search_matches_naive) {
+    std::mt19937 rng(18);
+    for (size_t k = 0; k < 150; k++) {
+        auto regex = random_regex(rng);
+        auto pattern = compile_pattern(regex);
+        if (!pattern || !pattern->regular) continue;
+        for (size_t b = 0; b < 6; b++) {
+            std::string buffer;
+            for (size_t i = 0, size = rng() % 14; i < size; i++) buffer += "abc"[rng() % 3];
+            auto expected = naive_search(*pattern, buffer);
+            std::vector<SearchMatch> matches;
+            search_pattern(*pattern, buffer, SearchMode::ALL, matches);
+            bool same = matches.size() == expected.size();
+            for (size_t i = 0; same && i < matches.size(); i++) {
+                same = matches[i].span.start == expected[i].start && matches[i].span.end == expected[i].end;
+                same = same && matches[i].groups.size() == pattern->groups.size();
+            }
+            CHECK_ON(same, regex, buffer);
+            std::vector<SearchMatch> longest;
+            search_pattern(*pattern, buffer, SearchMode::LONGEST, longest);
+            CHECK_ON(longest.size() == std::min<size_t>(expected.size(), 1), regex, buffer);
+        }
+    }
+}
+
+// Groups report the last span they matched, or none when they did not take part
+TEST(search_group_spans) {
+    auto pattern = compile_pattern("(a|(b))+c");
+    std::vector<SearchMatch> matches;
+    CHECK(search_pattern(*pattern, "xbac abcab", SearchMode::ALL, matches) && matches.size() == 2);
+    if (matches.size() != 2) return;
+    CHECK(matches[0].span.start == 1 && matches[0].span.end == 4);
+    CHECK(matches[0].groups[0].start == 2 && matches[0].groups[0].end == 3);
+    CHECK(matches[0].groups[1].start == 1 && matches[0].groups[1].end == 2);
+    CHECK(matches[1].span.start == 5 && matches[1].span.end == 8);
+    CHECK(matches[1].groups[0].start == 6 && matches[1].groups[1].start == 6);
+}
+
+// Every wanted byte gets its first position, across the vector blocks and the tail
+TEST(first_positions_scan) {
+    std::mt19937 rng(21);
+    for (size_t k = 0; k < 200; k++) {
+        std::string input(rng() % 300, '\0');
+        for (auto& c : input) c = static_cast<char>(rng() % 64 + ((k % 2) ? 128 : 32));
+        CharClass wanted;
+        for (size_t i = 0, count = rng() % 40; i < count; i++) wanted[rng() % 256] = true;
+        BytePositions first;
+        first_positions(input, wanted, first);
+        for (size_t b = 0; b < 256; b++) {
+            CHECK(first[b] == (wanted[b] ? input.find(static_cast<char>(b)) : std::string::npos));
+        }
+    }
+}
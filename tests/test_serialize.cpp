@@ -0,0 +1,104 @@
+#include "check.hpp"
+#include "frags.hpp"
+#include "matching.hpp"
+#include "parse.hpp"
+#include "pattern.hpp"
+#include "serialize.hpp"
+
+namespace {
+
+// A well-formed record of regex, compiled as compile_pattern does but with damage done
+// to its derived fields before writing
+std::string damaged_record(std::string_view regex, void (*damage)(CompiledPattern&)) {
+    CompiledPattern pattern;
+    pattern.text = std::string{regex};
+    pattern.tree = parse(pattern.text);
+    gen_frags(pattern.tree);
+    gen_lengths(pattern.tree);
+    set_depths(&root(pattern.tree));
+    compile_engines(pattern);
+    damage(pattern);
+    std::string bytes;
+    write_pattern(pattern, bytes);
+    return bytes;
+}
+
+}
+
+TEST(serialize_round_trip) {
+    std::mt19937 rng(23);
+    auto inputs = all_inputs("ab", 5);
+    for (size_t k = 0; k < 200; k++) {
+        auto regex = random_regex(rng, 2, k % 2 == 1);
+        auto pattern = compile_pattern(regex);
+        if (!pattern) continue;
+        std::string bytes;
+        write_pattern(*pattern, bytes);
+        CHECK_ON(is_pattern_data(bytes), regex, "");
+        size_t used = 0;
+        auto loaded = read_pattern(bytes, used);
+        CHECK_ON(loaded && used == bytes.size(), regex, "");
+        if (!loaded) continue;
+        CHECK_ON(loaded->text == pattern->text, regex, "");
+        CHECK_ON(loaded->regular == pattern->regular && loaded->backrefs == pattern->backrefs, regex, "");
+        CHECK_ON(loaded->tree.nodes.size() == pattern->tree.nodes.size(), regex, "");
+        // Stored, not rebuilt, so compare them with what compilation derives
+        CHECK_ON(loaded->literals.size() == pattern->literals.size(), regex, "");
+        CHECK_ON(!loaded->glushkov == !pattern->glushkov, regex, "");
+        if (loaded->glushkov && pattern->glushkov) {
+            const auto& a = *loaded->glushkov;
+            const auto& b = *pattern->glushkov;
+            CHECK_ON(a.positions == b.positions && a.accept == b.accept && a.byte_mask == b.byte_mask && a.follow == b.follow, regex, "");
+        }
+        std::string again;
+        write_pattern(*loaded, again);
+        CHECK_ON(again == bytes, regex, "");
+        MatchScratch original, copy;
+        for (const auto& input : inputs) {
+            auto expected = query_pattern(*pattern, input, original, MatchMode::EXISTS);
+            auto actual = query_pattern(*loaded, input, copy, MatchMode::EXISTS);
+            CHECK_ON(actual.found == expected.found, regex, input);
+        }
+    }
+}
+
+TEST(serialize_rejects_damage) {
+    auto pattern = compile_pattern("(ab|c)*d");
+    std::string bytes;
+    write_pattern(*pattern, bytes);
+    write_pattern(*pattern, bytes);
+    std::vector<std::shared_ptr<const CompiledPattern>> patterns;
+    CHECK(read_patterns(bytes, patterns) && patterns.size() == 2);
+    size_t used = 0;
+    for (size_t cut = 0; cut < bytes.size() / 2; cut++) {
+        CHECK(!read_pattern(std::string_view(bytes).substr(0, cut), used));
+    }
+    std::string versioned = bytes;
+    versioned[sizeof(uint64_t)] ^= 1;
+    CHECK(!read_pattern(versioned, used));
+    CHECK(!read_patterns(bytes.substr(0, bytes.size() - 1), patterns));
+}
+
+// Records whose flags, refs or lengths disagree with their tree are refused rather than
+// handed to an engine that trusts them
+TEST(serialize_rejects_corrupt_records) {
+    size_t used = 0;
+    CHECK(read_pattern(damaged_record("(a)\\1", [](CompiledPattern&) {}), used));
+    CHECK(!read_pattern(damaged_record("(a)\\1", [](CompiledPattern& p) {
+        for (auto& expr : p.tree.nodes) expr.ref_id = 0;
+        p.regular = p.backrefs = false;
+    }), used));
+    CHECK(!read_pattern(damaged_record("(a)\\1", [](CompiledPattern& p) {
+        p.backrefs = false;
+        p.countable = false;
+    }), used));
+    CHECK(!read_pattern(damaged_record("(ab|c)*d", [](CompiledPattern& p) {
+        p.regular = p.bit_parallel = p.countable = false;
+    }), used));
+    CHECK(!read_pattern(damaged_record("(ab|c)*d", [](CompiledPattern& p) {
+        p.tree.cold[0].lengths = {5, 2, 1};
+    }), used));
+    CHECK(!read_pattern(damaged_record("(ab|c)*d", [](CompiledPattern& p) {
+        p.tree.cold[1].lengths = {1, 3, 0};
+    }), used));
+}
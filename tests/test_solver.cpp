@@ -0,0 +1,77 @@
+#include "check.hpp"
+#include "frags.hpp"
+#include "pattern.hpp"
+#include "solver_interface.hpp"
+#include <algorithm>
+
+namespace {
+
+using Assignment = std::unordered_map<std::string, size_t>;
+
+// Solutions as sorted name=value lists, so they compare regardless of order
+std::vector<std::vector<std::pair<std::string, size_t>>> sorted(const std::vector<Assignment>& solutions) {
+    std::vector<std::vector<std::pair<std::string, size_t>>> result;
+    for (const auto& sol : solutions) {
+        result.emplace_back(sol.begin(), sol.end());
+        std::sort(result.back().begin(), result.back().end());
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+bool satisfies(const Constraint& con, const Assignment& sol) {
+    size_t sum = 0;
+    for (const auto& term : con.lhs) {
+        size_t product = term.coeff;
+        for (const auto& var : term.vars) {
+            auto it = sol.find(var_name(var));
+            if (it == sol.end() || it->second < var.n || it->second > var.m) return false;
+            product *= it->second;
+        }
+        sum += product;
+    }
+    return (con.rel == RelType::EQ) ? sum == con.rhs : sum <= con.rhs;
+}
+
+}
+
+TEST(solver_known_systems) {
+    CHECK((sorted(solve_eq("1*{x0:2,3}+2*{x1}=7")) == sorted({{{"x0", 3}, {"x1", 2}}})));
+    CHECK((sorted(solve_eq("1*{x0:2,3}+2*{x1}=8")) == sorted({{{"x0", 2}, {"x1", 3}}})));
+    CHECK(solve_eq("2*{x0}=7").empty());
+
+    // (ab|c)+ over 4 bytes: ab twice, c four times, or the mixes in between
+    auto pattern = compile_pattern("(ab|c)+");
+    CHECK(pattern != nullptr);
+    if (!pattern) return;
+    std::vector<Assignment> expected = {
+        {{"b0", 0}, {"b1", 1}, {"x0", 1}, {"x1", 4}},
+        {{"b0", 0}, {"b1", 1}, {"x0", 2}, {"x1", 2}},
+        {{"b0", 0}, {"b1", 1}, {"x0", 4}, {"x1", 1}},
+        {{"b0", 1}, {"b1", 0}, {"x0", 1}, {"x1", 2}},
+        {{"b0", 1}, {"b1", 0}, {"x0", 2}, {"x1", 1}},
+    };
+    CHECK(sorted(solve_expr(pattern->tree, 4)) == sorted(expected));
+}
+
+// Every enumerated assignment is distinct and satisfies the whole system, and the rendered
+// equation solves to the same assignments as the tree
+TEST(solver_assignments_satisfy) {
+    std::mt19937 rng(20);
+    for (size_t k = 0; k < 60; k++) {
+        auto regex = random_regex(rng, 1);
+        auto pattern = compile_pattern(regex);
+        if (!pattern) continue;
+        for (size_t size = 0; size <= 5; size++) {
+            auto system = gen_system(pattern->tree, size);
+            auto solutions = solve_expr(pattern->tree, size);
+            auto ordered = sorted(solutions);
+            CHECK_ON(std::adjacent_find(ordered.begin(), ordered.end()) == ordered.end(), regex, std::to_string(size));
+            for (const auto& sol : solutions) {
+                bool ok = std::all_of(system.begin(), system.end(), [&](const Constraint& con) { return satisfies(con, sol); });
+                CHECK_ON(ok, regex, std::to_string(size));
+            }
+            CHECK_ON(sorted(solve_eq(gen_eqs(pattern->tree, size))) == ordered, regex, std::to_string(size));
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#include "check.hpp"
+#include "pattern.hpp"
+#include "static_regex.hpp"
+
+namespace {
+
+template <FixedString Regex>
+constexpr bool accepted = requires { static_match<Regex>(""); };
+
+// 63 positions fit the 64-bit state, 64 do not
+static_assert(accepted<"a(bc){31}">);
+static_assert(!accepted<"(ab){32}">);
+static_assert(!accepted<"(a)\\1">);
+static_assert(!static_pattern<"(ab){32}">);
+
+static_assert(static_match<"[a-z]+\\.txt">("notes.txt"));
+static_assert(!static_match<"[a-z]+\\.txt">("notes.txt~"));
+static_assert(static_match<"abc">("abc") && !static_match<"abc">("ab"));
+static_assert(static_match<"(ab|c)*d">("abcabd") && !static_match<"(ab|c)*d">("abcab"));
+static_assert(static_match<"a(bc){31}">("a" "bcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbcbc"));
+
+template <FixedString Regex>
+void check_static(const std::vector<std::string>& inputs) {
+    auto pattern = compile_pattern(Regex.view());
+    CHECK_ON(pattern != nullptr, Regex.view(), "");
+    if (!pattern) return;
+    MatchScratch scratch;
+    for (const auto& input : inputs) {
+        bool expected = query_pattern(*pattern, input, scratch, MatchMode::EXISTS).found;
+        CHECK_ON(static_match<Regex>(input) == expected, Regex.view(), input);
+    }
+}
+
+}
+
+// Same whole-input answers as query_pattern, for literals and position automata alike
+TEST(static_match_agrees) {
+    auto inputs = all_inputs("abc", 5);
+    check_static<"abc">(inputs);
+    check_static<"(ab|c)*">(inputs);
+    check_static<"[^b]{1,3}c?">(inputs);
+    check_static<"(a|bc)+b*">(inputs);
+    check_static<"a{2,}|b{,2}">(inputs);
+    check_static<"\\w(c|a)?">(inputs);
+    check_static<"">(inputs);
+}
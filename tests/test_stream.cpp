@@ -0,0 +1,61 @@
+#include "check.hpp"
+#include "search.hpp"
+#include "stream.hpp"
+
+namespace {
+
+std::vector<Span> search_all(const CompiledPattern& pattern, std::string_view buffer) {
+    std::vector<SearchMatch> found;
+    search_pattern(pattern, buffer, SearchMode::ALL, found);
+    std::vector<Span> spans;
+    for (const auto& match : found) spans.push_back(match.span);
+    return spans;
+}
+
+bool same_spans(const std::vector<Span>& a, const std::vector<Span>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].start != b[i].start || a[i].end != b[i].end) return false;
+    }
+    return true;
+}
+
+std::vector<Span> stream_chunks(const CompiledPattern& pattern, const std::vector<std::string_view>& chunks) {
+    StreamMatcher stream;
+    std::vector<Span> spans;
+    if (!open_stream(pattern, stream)) return spans;
+    for (auto chunk : chunks) feed_stream(stream, chunk, spans);
+    close_stream(stream, spans);
+    return spans;
+}
+
+}
+
+// Wherever the chunks are cut, a stream reports what one search over the whole buffer does
+TEST(stream_chunk_boundaries) {
+    std::mt19937 rng(19);
+    std::uniform_int_distribution<int> coin(0, 1);
+    for (size_t k = 0; k < 100; k++) {
+        auto regex = random_regex(rng);
+        auto pattern = compile_pattern(regex);
+        if (!pattern || !pattern->regular) continue;
+        std::string buffer;
+        for (size_t i = 0; i < 16; i++) buffer += coin(rng) ? 'a' : 'b';
+        auto expected = search_all(*pattern, buffer);
+        std::string_view view = buffer;
+        for (size_t cut = 0; cut <= buffer.size(); cut++) {
+            CHECK_ON(same_spans(stream_chunks(*pattern, {view.substr(0, cut), view.substr(cut)}), expected), regex, buffer);
+        }
+        for (size_t width = 1; width <= 3; width++) {
+            std::vector<std::string_view> chunks;
+            for (size_t at = 0; at < buffer.size(); at += width) chunks.push_back(view.substr(at, width));
+            CHECK_ON(same_spans(stream_chunks(*pattern, chunks), expected), regex, buffer);
+        }
+    }
+}
+
+TEST(stream_rejects_backrefs) {
+    auto pattern = compile_pattern("(a)\\1");
+    StreamMatcher stream;
+    CHECK(!open_stream(*pattern, stream));
+}
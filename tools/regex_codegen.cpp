@@ -0,0 +1,38 @@
+#include "codegen.hpp"
+#include "pattern.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <string_view>
+
+// regex_codegen NAME REGEX [NAME REGEX ...]: writes a header defining one matcher
+// function per pair to stdout
+int main(int argc, char** argv) {
+    if (argc < 3 || argc % 2 == 0) {
+        std::cerr << "Usage: " << argv[0] << " NAME REGEX [NAME REGEX ...]\n";
+        return 1;
+    }
+    std::ostringstream out;
+    out << "// Generated by regex_codegen\n";
+    out << "#pragma once\n\n";
+    out << "#include <string_view>\n";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string_view name = argv[i];
+        if (!is_identifier(name)) {
+            std::cerr << name << " is not an identifier\n";
+            return 1;
+        }
+        auto pattern = compile_pattern(argv[i + 1]);
+        if (!pattern) {
+            std::cerr << "Parse failed.\n";
+            return 1;
+        }
+        out << "\n";
+        if (!generate_matcher(*pattern, name, out)) {
+            std::cerr << "Cannot generate " << name << ": back-references or too many DFA states\n";
+            return 1;
+        }
+    }
+    std::cout << out.str();
+    return 0;
+}